@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <SDL2/SDL2_gfxPrimitives.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -7,31 +11,40 @@
 #include "log.h"
 #include "mathc.h"
 
-
-static int compare_c_string(const void *const one, const void *const two)
-{
-	const unsigned char *a = (char *)one;
-	const unsigned char *b = (char *)two;
-
-	return strcmp(a, b);
-}
-
-
-vertex *create_vertex(double x, double y, double z) {
-    vertex *v = malloc(sizeof(vertex));
-    v->pos[0] = x;
-    v->pos[1] = y;
-    v->pos[2] = z;
-    v->pos[3] = 1;
-    v->colour = white;
-    return v;
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+//------------------------------------------------------------------------------
+// Agrandit un tableau (capacite doublee) pour contenir needed elements
+//------------------------------------------------------------------------------
+static int grow_array(void **array, int *capacity, int needed, size_t element_size) {
+    if (needed <= *capacity) {
+        return 1;
+    }
+    int new_capacity = *capacity > 0 ? *capacity : 16;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    void *a = realloc(*array, new_capacity * element_size);
+    if (a == NULL) {
+        return 0;
+    }
+    *array = a;
+    *capacity = new_capacity;
+    return 1;
 }
 
-vertex *create_vertex_color(double x, double y, double z, color c) {
-    vertex *v = create_vertex(x, y, z);
-    v->colour = c;
-    return v;
-}
 
 void set_normal(vertex *v, float x, float y, float z) {
     v->normal[0] = x;
@@ -48,181 +61,502 @@ void print_vertex(vertex *v) {
     printf(">[%lf %lf %lf %lf]\n", get_vertex_coord(v, 0), get_vertex_coord(v, 1), get_vertex_coord(v, 2), get_vertex_coord(v, 3));
 }
 
-void free_vertex(vertex *v) {
-    free(v);
+
+object *create_object() {
+    object *o = calloc(1, sizeof(object));
+    if (o != NULL) {
+        mat4_identity(o->model);
+    }
+    return o;
 }
 
 
-face *create_face(int length, ...) {
-    face *f = malloc(sizeof(face));
+static inline int next_capacity(int capacity, int needed) {
+    int c = capacity > 0 ? capacity : 16;
+    while (c < needed) {
+        c *= 2;
+    }
+    return c;
+}
+
+
+//------------------------------------------------------------------------------
+// Un seul bloc : sommets, puis faces, puis index. Quand un tableau deborde,
+// le bloc est realloue et les trois tableaux recopies. La projection suit la
+// capacite des sommets, son contenu n'a pas a etre conserve.
+//------------------------------------------------------------------------------
+int reserve_object(object *o, int vertices, int indexes, int faces) {
+    if (vertices <= o->vertices_capacity && indexes <= o->indexes_capacity && faces <= o->faces_capacity) {
+        return 1;
+    }
+    int vertices_capacity = vertices <= o->vertices_capacity ? o->vertices_capacity : next_capacity(o->vertices_capacity, vertices);
+    int indexes_capacity = indexes <= o->indexes_capacity ? o->indexes_capacity : next_capacity(o->indexes_capacity, indexes);
+    int faces_capacity = faces <= o->faces_capacity ? o->faces_capacity : next_capacity(o->faces_capacity, faces);
+
+    char *buffer = malloc(vertices_capacity * sizeof(vertex) + faces_capacity * sizeof(face) + indexes_capacity * sizeof(int));
+    if (buffer == NULL) {
+        return 0;
+    }
+    void *projection = o->projection;
+    if (vertices_capacity != o->vertices_capacity) {
+        projection = malloc(vertices_capacity * PROJECTED_VERTEX_SIZE);
+        if (projection == NULL) {
+            free(buffer);
+            return 0;
+        }
+        free(o->projection);
+    }
+    vertex *new_vertices = (vertex *)buffer;
+    face *new_faces = (face *)(new_vertices + vertices_capacity);
+    int *new_indexes = (int *)(new_faces + faces_capacity);
+    if (o->buffer != NULL) {
+        memcpy(new_vertices, o->vertices, o->vertices_count * sizeof(vertex));
+        memcpy(new_faces, o->faces, o->length * sizeof(face));
+        memcpy(new_indexes, o->indexes, o->indexes_count * sizeof(int));
+        free(o->buffer);
+    }
+
+    o->buffer = buffer;
+    o->projection = projection;
+    o->vertices = new_vertices;
+    o->faces = new_faces;
+    o->indexes = new_indexes;
+    o->vertices_capacity = vertices_capacity;
+    o->faces_capacity = faces_capacity;
+    o->indexes_capacity = indexes_capacity;
+    return 1;
+}
+
+void clear_object(object *o) {
+    o->vertices_count = 0;
+    o->indexes_count = 0;
+    o->length = 0;
+}
+
+
+int add_vertex_color(object *o, double x, double y, double z, color c) {
+    if (!reserve_object(o, o->vertices_count + 1, o->indexes_count, o->length)) {
+        return -1;
+    }
+    vertex *v = &o->vertices[o->vertices_count];
+    v->pos[0] = x;
+    v->pos[1] = y;
+    v->pos[2] = z;
+    v->pos[3] = 1;
+    set_normal(v, 0, 0, 0);
+    v->colour = c;
+    return o->vertices_count++;
+}
+
+int add_vertex(object *o, double x, double y, double z) {
+    return add_vertex_color(o, x, y, z, white);
+}
+
+
+int add_face_indexes(object *o, int length, int *indexes) {
+    if (!reserve_object(o, o->vertices_count, o->indexes_count + length, o->length + 1)) {
+        return -1;
+    }
+    face *f = &o->faces[o->length];
+    f->first = o->indexes_count;
     f->length = length;
-    f->vertices = vector_init(sizeof(vertex *));
+    memcpy(o->indexes + o->indexes_count, indexes, length * sizeof(int));
+    o->indexes_count += length;
+    return o->length++;
+}
+
+int add_face(object *o, int length, ...) {
+    int indexes[length > 0 ? length : 1];
     va_list valist;
     va_start(valist, length);
     for (int i = 0; i < length; i++) {
-        vertex *v = va_arg(valist, vertex*);
-        vector_add_last(f->vertices, &(v));
+        indexes[i] = va_arg(valist, int);
     }
     va_end(valist);
-    return f;
+    return add_face_indexes(o, length, indexes);
 }
 
-int add_vertex_to_face(face *f, vertex *v) {
-    if (f->vertices == NULL) {
-        return 0;
-    }
-    vector_add_last(f->vertices, &(v));
-    f->length ++;
-    return 1;
+
+vertex *get_face_vertex(object *o, face *f, int i) {
+    return &o->vertices[o->indexes[f->first + i]];
 }
 
-void compute_normal(face *f) {
+
+void compute_normal(object *o, face *f) {
     if (f->length > 1) {
 
         mfloat_t v1[3];
         mfloat_t v2[3];
-        mfloat_t *c = malloc(sizeof(mfloat_t) * VEC3_SIZE);
+        mfloat_t c[VEC3_SIZE];
 
-        vertex *vx0, *vx1, *vxn;
-        vector_get_at(&vx0, f->vertices, 0);
-        vector_get_at(&vx1, f->vertices, 1);
-        vector_get_at(&vxn, f->vertices, f->length - 1);
+        vertex *vx0 = get_face_vertex(o, f, 0);
+        vertex *vx1 = get_face_vertex(o, f, 1);
+        vertex *vxn = get_face_vertex(o, f, f->length - 1);
 
         vec3_subtract(v1, vx1->pos, vx0->pos);
         vec3_subtract(v2, vxn->pos, vx0->pos);
 
         vec3_cross(c, v1, v2);
 
-        vertex *v;
         for (int i = 0; i < f->length; i++) {
-            vector_get_at(&v, f->vertices, i);
-            set_normal(v, c[0], c[1], -c[2]);
+            set_normal(get_face_vertex(o, f, i), c[0], c[1], -c[2]);
         }
-        free(c);
     }
 }
 
-void free_face(face *f) {
-    vertex *v;
-    for (int i = 0; i < f->length; i++) {
-        vector_get_at(&v, f->vertices, i);
-        free_vertex(v);
+
+int count_vertices(object *o) {
+    return o->vertices_count;
+}
+
+void translate_object(object *o, mfloat_t* translation) {
+    transform_object(o, translation);
+}
+
+void transform_object(object *o, mfloat_t* transformation_matrix) {
+    for (int i = 0; i < o->vertices_count; i++) {
+        vec4_multiply_mat4(o->vertices[i].pos, o->vertices[i].pos, transformation_matrix);
+    }
+}
+
+void free_object(object *o) {
+    if (o == NULL) {
+        return;
     }
-    vector_destroy(f->vertices);
-    free(f);
+    free(o->buffer);
+    free(o->projection);
+    free(o);
 }
 
 
-object *create_object(int length, ...) {
-    object *o = malloc(sizeof(object));
-    o->length = length;
-    o->faces = vector_init(sizeof(face *));
-    // o->vertices_list = NULL;
-    o->vertices_lis = map_init(map_key_size, sizeof(vertex *), compare_c_string);
-    va_list valist;
-    va_start(valist, length);
-    for (int i = 0; i < length; i++) {
-        face *f = va_arg(valist, face *);
-        vector_add_last(o->faces, &(f));
+
+//------------------------------------------------------------------------------
+// mvp = projection * camera * model (model peut etre NULL). Sans projection,
+// camera est deja la matrice vue-projection combinee.
+//------------------------------------------------------------------------------
+void compute_mvp(mfloat_t *mvp, mfloat_t *model, mfloat_t *camera, mfloat_t *projection) {
+    if (projection != NULL) {
+        mat4_multiply(mvp, projection, camera);
+    } else {
+        mat4_assign(mvp, camera);
     }
-    va_end(valist);
-    update_vertices_list(o);
-    
-    return o;
+    if (model != NULL) {
+        mat4_multiply(mvp, mvp, model);
+    }
+}
+
+
+#define ORBIT_MAX_PITCH 1.55    // un peu moins de 90 degres, up reste valable
+#define ORBIT_MIN_DISTANCE 0.5
+#define ORBIT_MAX_DISTANCE 50.0
+
+void init_orbit_camera(orbit_camera *c, mfloat_t *position, mfloat_t *target, mfloat_t fov, mfloat_t aspect) {
+    mfloat_t offset[VEC3_SIZE];
+    vec3_subtract(offset, position, target);
+    vec3_assign(c->target, target);
+    c->distance = vec3_length(offset);
+    c->yaw = atan2(offset[0], offset[2]);
+    c->pitch = asin(offset[1] / c->distance);
+    c->fov = fov;
+    c->aspect = aspect;
+    c->changed = 1;
+    update_orbit_camera(c);
 }
 
+void orbit_camera_rotate(orbit_camera *c, mfloat_t yaw, mfloat_t pitch) {
+    c->yaw += yaw;
+    c->pitch = MAX(-ORBIT_MAX_PITCH, MIN(ORBIT_MAX_PITCH, c->pitch + pitch));
+    c->changed = 1;
+}
+
+void orbit_camera_zoom(orbit_camera *c, mfloat_t factor) {
+    c->distance = MAX(ORBIT_MIN_DISTANCE, MIN(ORBIT_MAX_DISTANCE, c->distance * factor));
+    c->changed = 1;
+}
 
-int add_face_to_object(object *o, face *f) {
-    if (o->faces == NULL) {
+void orbit_camera_pan(orbit_camera *c, mfloat_t dx, mfloat_t dy) {
+    // axes droite et haut de l'ecran
+    mfloat_t sy = sin(c->yaw), cy = cos(c->yaw);
+    mfloat_t sp = sin(c->pitch), cp = cos(c->pitch);
+    mfloat_t d = c->distance;
+    c->target[0] += d * (dx * cy - dy * sp * sy);
+    c->target[1] += d * (dy * cp);
+    c->target[2] += d * (-dx * sy - dy * sp * cy);
+    c->changed = 1;
+}
+
+int update_orbit_camera(orbit_camera *c) {
+    if (!c->changed) {
         return 0;
     }
-    vector_add_last(o->faces, &(f));
-    o->length ++;
-
-    // update_vertices_list(o);
-    update_vertices_list_from_face(o, f);
+    mfloat_t up[VEC3_SIZE];
+    mfloat_t cp = cos(c->pitch);
+    c->position[0] = c->target[0] + c->distance * cp * sin(c->yaw);
+    c->position[1] = c->target[1] + c->distance * sin(c->pitch);
+    c->position[2] = c->target[2] + c->distance * cp * cos(c->yaw);
+    mat4_look_at(c->view, c->position, c->target, vec3(up, 0.0, 1.0, 0.0));
+    mat4_perspective(c->projection, c->fov, c->aspect, 0.1, 100.0);
+    mat4_multiply(c->view_projection, c->projection, c->view);
+    c->changed = 0;
     return 1;
 }
 
-void update_vertices_list_from_face(object *o, face *f)
-{
-    char address[map_key_size];
-    vertex *v, *vf;
-    for (int j = 0; j < f->length; j++) {
-        vector_get_at(&v, f->vertices, j);
 
-        sprintf(address, "%p", v);
-        int inside = map_get(&vf, o->vertices_lis, address);
-        if (!inside) {
-            map_put(o->vertices_lis, address, &(v));
-        }
+//------------------------------------------------------------------------------
+// Transformation affine (w = 1) de n points, le resultat peut ecraser la
+// source. 8 points par tour avec AVX, 4 avec SSE2.
+//------------------------------------------------------------------------------
+void transform_batch(mfloat_t *m, const float *x, const float *y, const float *z, int n,
+    float *tx, float *ty, float *tz) {
+    int i = 0;
+
+#if defined(__AVX__)
+    __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+    __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+    __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+    __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]);
+    for (; i + 8 <= n; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, vx), _mm256_mul_ps(m4, vy)), _mm256_add_ps(_mm256_mul_ps(m8, vz), m12));
+        __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, vx), _mm256_mul_ps(m5, vy)), _mm256_add_ps(_mm256_mul_ps(m9, vz), m13));
+        __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, vx), _mm256_mul_ps(m6, vy)), _mm256_add_ps(_mm256_mul_ps(m10, vz), m14));
+        _mm256_storeu_ps(tx + i, rx);
+        _mm256_storeu_ps(ty + i, ry);
+        _mm256_storeu_ps(tz + i, rz);
+    }
+#elif defined(__SSE2__)
+    __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m4, vy)), _mm_add_ps(_mm_mul_ps(m8, vz), m12));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, vx), _mm_mul_ps(m5, vy)), _mm_add_ps(_mm_mul_ps(m9, vz), m13));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, vx), _mm_mul_ps(m6, vy)), _mm_add_ps(_mm_mul_ps(m10, vz), m14));
+        _mm_storeu_ps(tx + i, rx);
+        _mm_storeu_ps(ty + i, ry);
+        _mm_storeu_ps(tz + i, rz);
+    }
+#endif
 
+    for (; i < n; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        tx[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        ty[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        tz[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
     }
 }
 
-void update_vertices_list(object *o) {
-    map_clear(o->vertices_lis);
-    char address[map_key_size];
-    vertex *v, *vf;
-    for (int i = 0; i < o->length; i++) {
-        face *f;
-        vector_get_at(&f, o->faces, i);
-        for (int j = 0; j < f->length; j++) {
-            vector_get_at(&v, f->vertices, j);
-            sprintf(address, "%p", v);
-            int inside = map_get(&vf, o->vertices_lis, address);
-            if (!inside) {
-                printf("$ not inside");
-                map_put(o->vertices_lis, address, &(v));
-            }
+
+//------------------------------------------------------------------------------
+// Transformation par mvp, division perspective et passage en coordonnees
+// ecran de n points. visible vaut 1 si le point est dans [-1, 1] en x et y,
+// depth recoit w (distance a la camera).
+//------------------------------------------------------------------------------
+void transform_project_batch(mfloat_t *m, const float *x, const float *y, const float *z, int n,
+    int w, int h, int *sx, int *sy, float *depth, unsigned char *visible) {
+    int i = 0;
+    float half_w = 0.5f * w, half_h = 0.5f * h;
+
+#if defined(__AVX__)
+    __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m3 = _mm256_set1_ps(m[3]);
+    __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m7 = _mm256_set1_ps(m[7]);
+    __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m11 = _mm256_set1_ps(m[11]);
+    __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m15 = _mm256_set1_ps(m[15]);
+    __m256 one = _mm256_set1_ps(1.0f), minus_one = _mm256_set1_ps(-1.0f);
+    __m256 hw = _mm256_set1_ps(half_w), hh = _mm256_set1_ps(half_h);
+    __m256 max_x = _mm256_set1_ps(w - 1), max_y = _mm256_set1_ps(h - 1);
+    for (; i + 8 <= n; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        __m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, vx), _mm256_mul_ps(m4, vy)), _mm256_add_ps(_mm256_mul_ps(m8, vz), m12));
+        __m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, vx), _mm256_mul_ps(m5, vy)), _mm256_add_ps(_mm256_mul_ps(m9, vz), m13));
+        __m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m3, vx), _mm256_mul_ps(m7, vy)), _mm256_add_ps(_mm256_mul_ps(m11, vz), m15));
+        __m256 inv_w = _mm256_div_ps(one, cw);
+        __m256 px = _mm256_mul_ps(cx, inv_w);
+        __m256 py = _mm256_mul_ps(cy, inv_w);
+        __m256 in = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(px, minus_one, _CMP_GE_OQ), _mm256_cmp_ps(px, one, _CMP_LE_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(py, minus_one, _CMP_GE_OQ), _mm256_cmp_ps(py, one, _CMP_LE_OQ)));
+        __m256 fx = _mm256_min_ps(max_x, _mm256_mul_ps(_mm256_add_ps(px, one), hw));
+        __m256 fy = _mm256_min_ps(max_y, _mm256_mul_ps(_mm256_sub_ps(one, py), hh));
+        _mm256_storeu_si256((__m256i *)(sx + i), _mm256_cvttps_epi32(fx));
+        _mm256_storeu_si256((__m256i *)(sy + i), _mm256_cvttps_epi32(fy));
+        _mm256_storeu_ps(depth + i, cw);
+        int mask = _mm256_movemask_ps(in);
+        for (int j = 0; j < 8; j++) {
+            visible[i + j] = (mask >> j) & 1;
         }
     }
+#elif defined(__SSE2__)
+    __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m3 = _mm_set1_ps(m[3]);
+    __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m7 = _mm_set1_ps(m[7]);
+    __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m11 = _mm_set1_ps(m[11]);
+    __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m15 = _mm_set1_ps(m[15]);
+    __m128 one = _mm_set1_ps(1.0f), minus_one = _mm_set1_ps(-1.0f);
+    __m128 hw = _mm_set1_ps(half_w), hh = _mm_set1_ps(half_h);
+    __m128 max_x = _mm_set1_ps(w - 1), max_y = _mm_set1_ps(h - 1);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m4, vy)), _mm_add_ps(_mm_mul_ps(m8, vz), m12));
+        __m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, vx), _mm_mul_ps(m5, vy)), _mm_add_ps(_mm_mul_ps(m9, vz), m13));
+        __m128 cw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, vx), _mm_mul_ps(m7, vy)), _mm_add_ps(_mm_mul_ps(m11, vz), m15));
+        __m128 inv_w = _mm_div_ps(one, cw);
+        __m128 px = _mm_mul_ps(cx, inv_w);
+        __m128 py = _mm_mul_ps(cy, inv_w);
+        __m128 in = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(px, minus_one), _mm_cmple_ps(px, one)),
+            _mm_and_ps(_mm_cmpge_ps(py, minus_one), _mm_cmple_ps(py, one)));
+        __m128 fx = _mm_min_ps(max_x, _mm_mul_ps(_mm_add_ps(px, one), hw));
+        __m128 fy = _mm_min_ps(max_y, _mm_mul_ps(_mm_sub_ps(one, py), hh));
+        _mm_storeu_si128((__m128i *)(sx + i), _mm_cvttps_epi32(fx));
+        _mm_storeu_si128((__m128i *)(sy + i), _mm_cvttps_epi32(fy));
+        _mm_storeu_ps(depth + i, cw);
+        int mask = _mm_movemask_ps(in);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for (; i < n; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        float cx = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        float cy = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        float cw = m[3] * px + m[7] * py + m[11] * pz + m[15];
+        float nx = cx / cw;
+        float ny = cy / cw;
+
+        visible[i] = nx >= -1 && nx <= 1 && ny >= -1 && ny <= 1;
+        sx[i] = (int)MIN(w - 1, (nx + 1) * half_w);
+        sy[i] = (int)MIN(h - 1, (1 - ny) * half_h);
+        depth[i] = cw;
+    }
 }
 
-void translate_object(object *o, mfloat_t* translation) {
-    char *current_key = map_first(o->vertices_lis);
-    vertex *v;
-    while (current_key != NULL) {
-        map_get(&v, o->vertices_lis, current_key);
-        vec4_multiply_mat4(v->pos, v->pos, translation);
-        current_key = map_higher(o->vertices_lis, current_key);
+
+//------------------------------------------------------------------------------
+// Decoupe buffer en tableaux : les float, puis les int, puis les octets
+//------------------------------------------------------------------------------
+static void carve_point_cloud(point_cloud *pc, void *buffer, int capacity) {
+    float *f = buffer;
+    pc->x = f;
+    pc->y = f + capacity;
+    pc->z = f + 2 * capacity;
+    pc->depth = f + 3 * capacity;
+    int *i = (int *)(f + 4 * capacity);
+    pc->sx = i;
+    pc->sy = i + capacity;
+    unsigned char *b = (unsigned char *)(i + 2 * capacity);
+    pc->r = b;
+    pc->g = b + capacity;
+    pc->b = b + 2 * capacity;
+    pc->visible = b + 3 * capacity;
+    pc->buffer = buffer;
+    pc->capacity = capacity;
+}
+
+static const size_t point_size = 4 * sizeof(float) + 2 * sizeof(int) + 4;
+
+
+point_cloud *create_point_cloud(int capacity) {
+    point_cloud *pc = calloc(1, sizeof(point_cloud));
+    if (pc == NULL) {
+        return NULL;
     }
+    mat4_identity(pc->model);
+    if (!reserve_point_cloud(pc, capacity > 0 ? capacity : 16)) {
+        free(pc);
+        return NULL;
+    }
+    return pc;
 }
 
-void transform_object(object *o, mfloat_t* transformation_matrix) {
-    fflush(stdout);
-    char *current_key = map_first(o->vertices_lis);
-    vertex *v;
-    fflush(stdout);
-    while (current_key != NULL) {
-        map_get(&v, o->vertices_lis, current_key);
-        vec4_multiply_mat4(v->pos, v->pos, transformation_matrix);
-        current_key = map_higher(o->vertices_lis, current_key);
+int reserve_point_cloud(point_cloud *pc, int capacity) {
+    if (capacity <= pc->capacity) {
+        return 1;
+    }
+    void *buffer = malloc(point_size * capacity);
+    if (buffer == NULL) {
+        return 0;
+    }
+    point_cloud old = *pc;
+    carve_point_cloud(pc, buffer, capacity);
+    if (old.buffer != NULL) {
+        memcpy(pc->x, old.x, pc->length * sizeof(float));
+        memcpy(pc->y, old.y, pc->length * sizeof(float));
+        memcpy(pc->z, old.z, pc->length * sizeof(float));
+        memcpy(pc->r, old.r, pc->length);
+        memcpy(pc->g, old.g, pc->length);
+        memcpy(pc->b, old.b, pc->length);
+        free(old.buffer);
     }
+    return 1;
 }
 
-void free_object(object *o) {
-    char *current_key = map_first(o->vertices_lis);
-    vertex *v;
-    while (current_key != NULL) {
-        map_get(&v, o->vertices_lis, current_key);
-        free_vertex(v);
-        current_key = map_higher(o->vertices_lis, current_key);
+int add_point(point_cloud *pc, float x, float y, float z, color c) {
+    if (pc->length == pc->capacity && !reserve_point_cloud(pc, pc->capacity * 2)) {
+        return -1;
     }
+    int i = pc->length++;
+    pc->x[i] = x;
+    pc->y[i] = y;
+    pc->z[i] = z;
+    pc->r[i] = c.r;
+    pc->g[i] = c.g;
+    pc->b[i] = c.b;
+    return i;
+}
 
-    // Suppression des faces
-    for (int i = 0; i < o->length; i++) {
-        face *f;
-        vector_get_at(&f, o->faces, i);
-        free(f);
+void clear_point_cloud(point_cloud *pc) {
+    pc->length = 0;
+}
+
+void transform_point_cloud(point_cloud *pc, mfloat_t *m) {
+    transform_batch(m, pc->x, pc->y, pc->z, pc->length, pc->x, pc->y, pc->z);
+}
+
+#define PROJECT_CHUNK 8192
+
+void project_point_cloud(point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int w, int h) {
+    mfloat_t m[MAT4_SIZE];
+    compute_mvp(m, pc->model, camera, projection);
+
+    // decoupage en blocs (multiples de 8) projetes en parallele
+    int chunks = (pc->length + PROJECT_CHUNK - 1) / PROJECT_CHUNK;
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < chunks; c++) {
+        int first = c * PROJECT_CHUNK;
+        int n = MIN(PROJECT_CHUNK, pc->length - first);
+        transform_project_batch(m, pc->x + first, pc->y + first, pc->z + first, n, w, h,
+            pc->sx + first, pc->sy + first, pc->depth + first, pc->visible + first);
     }
-    vector_destroy(o->faces);
+}
 
-    // Suppression de la liste
-    map_destroy(o->vertices_lis);
+void free_point_cloud(point_cloud *pc) {
+    if (pc == NULL) {
+        return;
+    }
+    free(pc->buffer);
+    free(pc);
+}
 
-    // Suppression de l'objet
-    free(o);
+void point_cloud_view(point_cloud *view, point_cloud *pc, int offset, int length) {
+    memcpy(view->model, pc->model, sizeof(view->model));
+    view->length = length;
+    view->capacity = length;
+    view->x = pc->x + offset;
+    view->y = pc->y + offset;
+    view->z = pc->z + offset;
+    view->depth = pc->depth + offset;
+    view->sx = pc->sx + offset;
+    view->sy = pc->sy + offset;
+    view->r = pc->r + offset;
+    view->g = pc->g + offset;
+    view->b = pc->b + offset;
+    view->visible = pc->visible + offset;
+    view->buffer = NULL;
 }
 
 
@@ -237,7 +571,9 @@ void create_sphere(object *o, int sectors, int stacks, float radius) {
     float stack_step = M_PI / stacks;
     float sector_angle, stack_angle;
 
-    vertex **vertices = malloc((sectors + 1) * (stacks + 1) * sizeof(vertex*));
+    int *vertices = malloc((sectors + 1) * (stacks + 1) * sizeof(int));
+    reserve_object(o, o->vertices_count + (sectors + 1) * (stacks + 1),
+        o->indexes_count + 6 * sectors * stacks, o->length + 2 * sectors * stacks);
 
     int count = 0;
     for(int i = 0; i <= stacks; ++i)
@@ -255,7 +591,7 @@ void create_sphere(object *o, int sectors, int stacks, float radius) {
             // vertex position (x, y, z)
             x = xy * cosf(sector_angle);             // r * cos(u) * cos(v)
             y = xy * sinf(sector_angle);             // r * cos(u) * sin(v)
-            vertices[count] = create_vertex(x, y, z);
+            vertices[count] = add_vertex(o, x, y, z);
 
             // normalized vertex normal (nx, ny, nz)
             nx = x * length_inv;
@@ -283,138 +619,307 @@ void create_sphere(object *o, int sectors, int stacks, float radius) {
 
             if(i != 0)
             {
-                face *f = create_face(3, vertices[k1], vertices[k2], vertices[k1 + 1]);
-                add_face_to_object(o, f);
-                compute_normal(f);
+                int f = add_face(o, 3, vertices[k1], vertices[k2], vertices[k1 + 1]);
+                compute_normal(o, &o->faces[f]);
             }
 
             // k1+1 => k2 => k2+1
             if(i != (stacks-1))
             {
-                face *f = create_face(3, vertices[k1 + 1], vertices[k2], vertices[k2 + 1]);
-                add_face_to_object(o, f);
-                compute_normal(f);
+                int f = add_face(o, 3, vertices[k1 + 1], vertices[k2], vertices[k2 + 1]);
+                compute_normal(o, &o->faces[f]);
             }
         }
 
     }
-    update_vertices_list(o);
+    free(vertices);
 }
 
 
-void create_obj(object *o, char *filename) {
-    FILE* filePointer;
-    int bufferLength = 1024;
-    char buffer[bufferLength];
-    char header[5];
-    int vertices_count = 0;
-    int normals_count = 0;
-    int i = 0;
+//------------------------------------------------------------------------------
+// Lecture du fichier en memoire : mmap en lecture seule, ou lecture complete
+// sous Windows
+//------------------------------------------------------------------------------
+static char *map_file(const char *filename, size_t *size) {
+#ifdef _WIN32
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = length > 0 ? malloc(length) : NULL;
+    if (data != NULL && fread(data, 1, length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = data != NULL ? (size_t)length : 0;
+    return data;
+#else
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+    return data;
+#endif
+}
+
+static void unmap_file(char *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(data);
+#else
+    munmap(data, size);
+#endif
+}
+
 
-    filePointer = fopen(filename, "r");
-    while(fgets(buffer, bufferLength, filePointer)) {
-        sscanf(buffer, "%s " , header);
-        if (strcmp("v", header) == 0) {
-            vertices_count ++;
+// Le fichier projete n'est pas termine par un 0 : tout est borne par end
+static inline const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *skip_line(const char *p, const char *end) {
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p < end ? p + 1 : end;
+}
+
+static float parse_float(const char **pp, const char *end) {
+    const char *p = skip_blanks(*pp, end);
+    float sign = 1.0f;
+    double value = 0.0;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        sign = *p == '-' ? -1.0f : 1.0f;
+        p++;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10.0 + (*p++ - '0');
+    }
+    if (p < end && *p == '.') {
+        double scale = 0.1;
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value += (*p++ - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int exponent = 0, exponent_sign = 1;
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponent_sign = *p == '-' ? -1 : 1;
+            p++;
         }
-        if (strcmp("vn", header) == 0) {
-            normals_count ++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            exponent = exponent * 10 + (*p++ - '0');
         }
+        value *= pow(10.0, exponent_sign * exponent);
     }
-    fclose(filePointer);
+    *pp = p;
+    return sign * value;
+}
 
-    printf("vertices count :%d\n", vertices_count);
-    vertex **vertex_list = malloc (sizeof(vertex *) * vertices_count);
+// Retourne 0 s'il n'y a pas d'entier a cette position
+static int parse_int(const char **pp, const char *end, int *value) {
+    const char *p = *pp;
+    int sign = 1, v = 0;
 
-    printf("normals count :%d\n", normals_count);
-    mfloat_t **normals_list = malloc (sizeof(mfloat_t *) * normals_count);
-
-    filePointer = fopen(filename, "r");
-    while(fgets(buffer, bufferLength, filePointer)) {
-        sscanf(buffer, "%s " , header);
-        if (strcmp("v", header) == 0) {
-            float x, y, z;
-            sscanf(buffer, "%s %f %f %f" , header, &x, &y, &z);
-            vertex *v = create_vertex(x, y, z);
-            vertex_list[i] = v;
-            i++;
+    if (p < end && *p == '-') {
+        sign = -1;
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return 0;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    *value = sign * v;
+    *pp = p;
+    return 1;
+}
+
+// Index OBJ (1..n, ou negatif relatif a la fin) vers 0..n-1, -1 si invalide
+static inline int obj_index(int index, int count) {
+    int i = index < 0 ? count + index : index - 1;
+    return i >= 0 && i < count ? i : -1;
+}
+
+
+//------------------------------------------------------------------------------
+// Table de hachage (position, normale) -> sommet de l'objet, adressage
+// ouvert, pour partager les sommets entre les faces
+//------------------------------------------------------------------------------
+typedef struct corner_entry {
+    unsigned long long key;     // 0 : case libre
+    int vertex;
+} corner_entry;
+
+typedef struct corner_table {
+    corner_entry *entries;
+    int capacity;               // puissance de 2
+    int count;
+} corner_table;
+
+static inline unsigned int hash_key(unsigned long long key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (unsigned int)key;
+}
+
+static int corner_table_grow(corner_table *t) {
+    int capacity = t->capacity > 0 ? t->capacity * 2 : 1024;
+    corner_entry *entries = calloc(capacity, sizeof(corner_entry));
+    if (entries == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < t->capacity; i++) {
+        if (t->entries[i].key != 0) {
+            unsigned int h = hash_key(t->entries[i].key) & (capacity - 1);
+            while (entries[h].key != 0) {
+                h = (h + 1) & (capacity - 1);
+            }
+            entries[h] = t->entries[i];
         }
+    }
+    free(t->entries);
+    t->entries = entries;
+    t->capacity = capacity;
+    return 1;
+}
 
+// Sommet du coin (v, vn), cree au premier usage ; -1 en cas d'erreur
+static int corner_vertex(object *o, corner_table *t, const float *positions, const float *normals, int v, int vn) {
+    if (2 * (t->count + 1) > t->capacity && !corner_table_grow(t)) {
+        return -1;
     }
-    fclose(filePointer);
-
-    i = 0;
-    filePointer = fopen(filename, "r");
-    while(fgets(buffer, bufferLength, filePointer)) {
-        sscanf(buffer, "%s " , header);
-        if (strcmp("vn", header) == 0) {
-            float x, y, z;
-            sscanf(buffer, "%s %f %f %f" , header, &x, &y, &z);
-            // printf("vn %f %f %f\n", x, y, z);
-            mfloat_t *n = malloc(sizeof(mfloat_t) * 3);
-            n[0] = x;
-            n[1] = y;
-            n[2] = z;
-            normals_list[i] = n;
-            i++;
+    unsigned long long key = ((unsigned long long)(v + 1) << 32) | (unsigned int)(vn + 1);
+    unsigned int h = hash_key(key) & (t->capacity - 1);
+    while (t->entries[h].key != 0) {
+        if (t->entries[h].key == key) {
+            return t->entries[h].vertex;
         }
+        h = (h + 1) & (t->capacity - 1);
+    }
+
+    int index = add_vertex(o, positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+    if (index < 0) {
+        return -1;
+    }
+    if (vn >= 0) {
+        set_normal(&o->vertices[index], normals[3 * vn], normals[3 * vn + 1], normals[3 * vn + 2]);
     }
-    fclose(filePointer);
-
-    filePointer = fopen(filename, "r");
-    int face_indexes[10];
-    int normal_indexes[10];
-    int k;
-    while(fgets(buffer, bufferLength, filePointer)) {
-        sscanf(buffer, "%s " , header);
-        if (strcmp("f", header) == 0) {
-            i = 0;
-            k = 0;
-            char *token;
-            const char s[2] = " ";
-            token = strtok(buffer, s);
-            while( token != NULL ) {
-                if (i>0) {
-                    // printf( "token %d %s\n", i, token );
-                    int i, j;
-                    sscanf(token, "%d//%d", &i, &j);
-                    // printf("   %d %d\n", i, j);
-                    face_indexes[k] = i;
-                    normal_indexes[k] = j;
-                    k++;
+    t->entries[h].key = key;
+    t->entries[h].vertex = index;
+    t->count++;
+    return index;
+}
+
+
+//------------------------------------------------------------------------------
+// Lecteur OBJ en une passe : v, vn et f (formes v, v/vt, v//vn, v/vt/vn,
+// index negatifs, polygones de taille quelconque). Les vt sont ignores.
+// Les coins de meme position et meme normale partagent un sommet.
+//------------------------------------------------------------------------------
+int create_obj(object *o, char *filename) {
+    size_t size;
+    char *data = map_file(filename, &size);
+    if (data == NULL) {
+        return 0;
+    }
+
+    float *positions = NULL, *normals = NULL;
+    int positions_count = 0, positions_capacity = 0;
+    int normals_count = 0, normals_capacity = 0;
+    int *corners = NULL, corners_capacity = 0;
+    corner_table table = { NULL, 0, 0 };
+    int ok = 1;
+
+    const char *p = data;
+    const char *end = data + size;
+    while (ok && p < end) {
+        p = skip_blanks(p, end);
+        if (end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            p++;
+            ok = grow_array((void **)&positions, &positions_capacity, 3 * (positions_count + 1), sizeof(float));
+            if (ok) {
+                float *v = positions + 3 * positions_count++;
+                v[0] = parse_float(&p, end);
+                v[1] = parse_float(&p, end);
+                v[2] = parse_float(&p, end);
+            }
+        } else if (end - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            p += 2;
+            ok = grow_array((void **)&normals, &normals_capacity, 3 * (normals_count + 1), sizeof(float));
+            if (ok) {
+                float *n = normals + 3 * normals_count++;
+                n[0] = parse_float(&p, end);
+                n[1] = parse_float(&p, end);
+                n[2] = parse_float(&p, end);
+            }
+        } else if (end - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            int k = 0;
+            p++;
+            for (;;) {
+                int v, vt, vn = 0;
+                p = skip_blanks(p, end);
+                if (!parse_int(&p, end, &v)) {
+                    break;
+                }
+                if (p < end && *p == '/') {
+                    p++;
+                    parse_int(&p, end, &vt);
+                    if (p < end && *p == '/') {
+                        p++;
+                        parse_int(&p, end, &vn);
+                    }
+                }
+                v = obj_index(v, positions_count);
+                vn = vn != 0 ? obj_index(vn, normals_count) : -1;
+                ok = v >= 0
+                    && grow_array((void **)&corners, &corners_capacity, k + 1, sizeof(int))
+                    && (corners[k] = corner_vertex(o, &table, positions, normals, v, vn)) >= 0;
+                if (!ok) {
+                    break;
                 }
-                token = strtok(NULL, s);
-                i++;
+                k++;
             }
-            // printf("k %d\n", k);
-            face *f = create_face(0);
-            for (i = 0; i < k; i++) {
-                // printf("face_indexes[%d]=%d\n", i, face_indexes[i]);
-                vertex *v = create_vertex(vertex_list[face_indexes[i] - 1]->pos[0], 
-                    vertex_list[face_indexes[i] - 1]->pos[1], 
-                    vertex_list[face_indexes[i] - 1]->pos[2]);
-                // print_vertex(v);
-                add_vertex_to_face(f, v);
-                // printf("normal_indexes[%d]=%d\n", i, normal_indexes[i]);
-                set_normal(v, normals_list[normal_indexes[i] - 1][0], 
-                    normals_list[normal_indexes[i] - 1][1], 
-                    normals_list[normal_indexes[i] - 1][2]);
-                //  print_vec3(v->normal);
+            if (ok && k > 0) {
+                ok = add_face_indexes(o, k, corners) >= 0;
             }
-            // printf("len %d\n", f->length);
-            add_face_to_object(o, f);
         }
+        p = skip_line(p, end);
     }
-    fclose(filePointer);
 
+    printf("vertices count :%d\n", positions_count);
+    printf("normals count :%d\n", normals_count);
 
-    free(vertex_list);
-    for (int i = 0; i < normals_count; i++) {
-        free(normals_list[i]);
-    }
-    free(normals_list);
-
-    update_vertices_list(o);
+    free(positions);
+    free(normals);
+    free(corners);
+    free(table.entries);
+    unmap_file(data, size);
+    return ok;
 }
 
 
@@ -442,55 +947,81 @@ void print_vec3(mfloat_t *v) {
 }
 
 
-void render_object(SDL_Renderer *r, object *o, mfloat_t *camera, mfloat_t *projection, int w, int h, int only_vertices, int vertice_size) {
+//------------------------------------------------------------------------------
+// Projection de toutes les positions de vertices en un seul passage par
+// transform_project_batch. Un seul bloc : x, y, z, depth, sx, sy, visible.
+//------------------------------------------------------------------------------
+static void project_into(void *buffer, vertex *vertices, int n, mfloat_t *mvp, int w, int h,
+    int **sx, int **sy, float **depth_out, unsigned char **visible) {
+    float *x = buffer;
+    float *y = x + n;
+    float *z = y + n;
+    float *depth = z + n;
+    *sx = (int *)(depth + n);
+    *sy = *sx + n;
+    *visible = (unsigned char *)(*sy + n);
+    if (depth_out != NULL) {
+        *depth_out = depth;
+    }
 
-    for (int i = 0; i < o->length; i++) {
+    for (int i = 0; i < n; i++) {
+        x[i] = vertices[i].pos[0];
+        y[i] = vertices[i].pos[1];
+        z[i] = vertices[i].pos[2];
+    }
+    transform_project_batch(mvp, x, y, z, n, w, h, *sx, *sy, depth, *visible);
+}
+
+void *project_vertices(vertex *vertices, int n, mfloat_t *mvp, int w, int h,
+    int **sx, int **sy, float **depth, unsigned char **visible) {
+    void *buffer = malloc((size_t)n * PROJECTED_VERTEX_SIZE);
+    if (buffer != NULL) {
+        project_into(buffer, vertices, n, mvp, w, h, sx, sy, depth, visible);
+    }
+    return buffer;
+}
 
-        face *f;
-        vector_get_at(&f, o->faces, i);
+int project_object(object *o, mfloat_t *mvp, int w, int h,
+    int **sx, int **sy, float **depth, unsigned char **visible) {
+    if (o->projection == NULL) {
+        return 0;
+    }
+    project_into(o->projection, o->vertices, o->vertices_count, mvp, w, h, sx, sy, depth, visible);
+    return 1;
+}
 
-        int paint_polygon = 1;
-        mfloat_t center_face[VEC3_SIZE];
-        mfloat_t normal_face[VEC3_SIZE];
-        vec3(center_face, 0, 0, 0);
-        vec3(normal_face, 0, 0, 0);
-        Sint16 *xs = malloc(sizeof(Sint16) * f->length);
-        Sint16 *ys = malloc(sizeof(Sint16) * f->length);
-        color c;
-        vertex *world_vertex;
 
-		for (int j = 0; j < f->length; j++) {
+void render_object(SDL_Renderer *r, object *o, mfloat_t *camera, mfloat_t *projection, int w, int h, int only_vertices, int vertice_size) {
+    mfloat_t mvp[MAT4_SIZE];
+    int *sx, *sy;
+    unsigned char *visible;
+
+    if (o->vertices_count == 0) {
+        return;
+    }
+    compute_mvp(mvp, o->model, camera, projection);
+    if (!project_object(o, mvp, w, h, &sx, &sy, NULL, &visible)) {
+        return;
+    }
 
-            vector_get_at(&world_vertex, f->vertices, j);
+    for (int i = 0; i < o->length; i++) {
 
-			float_t *world_pos = world_vertex->pos;
-            float_t *world_norm = world_vertex->normal;
-            vec3_add(center_face, center_face, world_pos);
-            vec3_add(normal_face, normal_face, world_norm);
+        face *f = &o->faces[i];
 
-			float_t camera_pos[4];
-			vec4_multiply_mat4(camera_pos, world_pos, camera);
+        int paint_polygon = 1;
+        Sint16 xs[f->length];
+        Sint16 ys[f->length];
 
-			float_t projection_pos[4];
-			vec4_multiply_mat4(projection_pos, camera_pos, projection);
+		for (int j = 0; j < f->length; j++) {
+            int v = o->indexes[f->first + j];
+            vertex *world_vertex = &o->vertices[v];
 
-			vec4_divide_f(projection_pos, projection_pos, projection_pos[3]);
-            
-            if (projection_pos[0] < -1 
-                || projection_pos[0] > 1 
-                || projection_pos[1] < -1 
-                || projection_pos[1] > 1)
+            if (!visible[v])
                 paint_polygon = 0;
-                    
-            // creation du polygon x,y projete et z non projete
-            mfloat_t *vertex_poly = malloc(3 * sizeof(mfloat_t));
-            vertex_poly[0] = MIN(w - 1, (uint32_t)((projection_pos[0] + 1) * 0.5 * w));
-            vertex_poly[1] = MIN(h - 1, (uint32_t)((1 - (projection_pos[1] + 1) * 0.5) * h));
-            vertex_poly[2] = camera_pos[2];
-            // polygon_proj[j] = vertex_poly;
-            xs[j] = vertex_poly[0];
-            ys[j] = vertex_poly[1];
-            c = world_vertex->colour;
+
+            // polygon x,y projete
+            xs[j] = sx[v];
+            ys[j] = sy[v];
 
             if (only_vertices && paint_polygon) {
                 if (vertice_size <= 1) {
@@ -500,35 +1031,49 @@ void render_object(SDL_Renderer *r, object *o, mfloat_t *camera, mfloat_t *proje
                     aacircleRGBA(r, xs[j], ys[j], vertice_size, 255, 255, 255, 255);
                 }
             }
-            free(vertex_poly);
 		}
 
         if (paint_polygon && !only_vertices) {
             aapolygonRGBA(r, xs, ys, f->length, 64, 64, 64, 128);
         }
-
-        free(xs);
-        free(ys);
 	}
 }
 
 
-void render_vertices(SDL_Renderer *r, vertex **vertices, int length, mfloat_t *camera, mfloat_t *projection, int w, int h) {
-    for (int j = 0; j < length; j++) {
-        vertex *world_vertex = vertices[j];
-        float_t *world_pos = world_vertex->pos;
+void render_point_cloud(SDL_Renderer *r, point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int w, int h, int vertice_size) {
+    project_point_cloud(pc, camera, projection, w, h);
 
-        float_t camera_pos[4];
-        vec4_multiply_mat4(camera_pos, world_pos, camera);
+    for (int i = 0; i < pc->length; i++) {
+        if (!pc->visible[i]) {
+            continue;
+        }
+        if (vertice_size <= 1) {
+            pixelRGBA(r, pc->sx[i], pc->sy[i], pc->r[i], pc->g[i], pc->b[i], 255);
+        } else {
+            filledCircleRGBA(r, pc->sx[i], pc->sy[i], vertice_size, pc->r[i], pc->g[i], pc->b[i], 255);
+            aacircleRGBA(r, pc->sx[i], pc->sy[i], vertice_size, 255, 255, 255, 255);
+        }
+    }
+}
 
-        float_t projection_pos[4];
-        vec4_multiply_mat4(projection_pos, camera_pos, projection);
 
-        vec4_divide_f(projection_pos, projection_pos, projection_pos[3]);
+void render_vertices(SDL_Renderer *r, vertex *vertices, int length, mfloat_t *camera, mfloat_t *projection, int w, int h) {
+    mfloat_t mvp[MAT4_SIZE];
+    int *sx, *sy;
+    unsigned char *visible;
 
-        float x = MIN(w - 1, (uint32_t)((projection_pos[0] + 1) * 0.5 * w)); 
-        float y = MIN(h - 1, (uint32_t)((1 - (projection_pos[1] + 1) * 0.5) * h));
+    if (length == 0) {
+        return;
+    }
+    compute_mvp(mvp, NULL, camera, projection);
+    void *buffer = project_vertices(vertices, length, mvp, w, h, &sx, &sy, NULL, &visible);
+    if (buffer == NULL) {
+        return;
+    }
 
-        pixelRGBA(r, x, y, world_vertex->colour.r, world_vertex->colour.g, world_vertex->colour.b, 255);
+    for (int j = 0; j < length; j++) {
+        pixelRGBA(r, sx[j], sy[j], vertices[j].colour.r, vertices[j].colour.g, vertices[j].colour.b, 255);
     }
+
+    free(buffer);
 }
@@ -6,8 +6,6 @@
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_stdinc.h>
 #include "mathc.h"
-#include <vector.h>
-#include <map.h>
 
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -35,46 +33,131 @@ typedef struct vertex {
     color colour;
 } vertex;
 
+// Une face est une suite de length index de sommets, a partir de
+// object.indexes[first]
 typedef struct face {
-    vector vertices;
+    int first;
     int length;
 } face;
 
-static const int map_key_size = 64;
-
+// Les sommets, les faces et les index des faces sont des tableaux contigus
+// decoupes dans un seul bloc possede par l'objet (buffer), libere d'un coup.
+// Les sommets ne sont pas modifies au rendu, model est applique a la
+// projection.
 typedef struct object {
-    vector faces;
+    mfloat_t model[MAT4_SIZE];
+    vertex *vertices;
+    int vertices_count;
+    int vertices_capacity;
+    int *indexes;
+    int indexes_count;
+    int indexes_capacity;
+    face *faces;
     int length;
-    map vertices_lis;
+    int faces_capacity;
+    void *buffer;
+    // projection des sommets (x, y, z, depth, sx, sy, visible) dimensionnee
+    // par reserve_object et reutilisee a chaque rendu
+    void *projection;
 } object;
 
+// Nuage de points : positions, couleurs et projection ecran en tableaux
+// separes dans une seule allocation, model est applique a la projection
+typedef struct point_cloud {
+    mfloat_t model[MAT4_SIZE];
+    int length;
+    int capacity;
+    float *x;
+    float *y;
+    float *z;
+    float *depth;
+    int *sx;
+    int *sy;
+    unsigned char *r;
+    unsigned char *g;
+    unsigned char *b;
+    unsigned char *visible;
+    void *buffer;
+} point_cloud;
+
+// Camera en orbite autour de target (angles en radians). La matrice
+// vue-projection combinee n'est recalculee qu'apres un changement.
+typedef struct orbit_camera {
+    mfloat_t target[VEC3_SIZE];
+    mfloat_t yaw;
+    mfloat_t pitch;
+    mfloat_t distance;
+    mfloat_t fov;
+    mfloat_t aspect;
+    mfloat_t position[VEC3_SIZE];
+    mfloat_t view[MAT4_SIZE];
+    mfloat_t projection[MAT4_SIZE];
+    mfloat_t view_projection[MAT4_SIZE];
+    int changed;
+} orbit_camera;
+
 typedef struct light {
     mfloat_t pos[VEC4_SIZE];
     mfloat_t intensity;
 } light;
 
-vertex *create_vertex(double x, double y, double z);
-vertex *create_vertex_color(double x, double y, double z, color c);
 void set_normal(vertex *v, float x, float y, float z);
-void free_vertex(vertex *v);
 void print_vertex(vertex *v);
 double get_vertex_coord(vertex *v, int i);
 
-face *create_face(int length, ...);
-int add_vertex_to_face(face *f, vertex *v);
-void compute_normal(face *f);
-void free_face(face *f);
-
-object *create_object(int length, ...);
-int add_face_to_object(object *o, face *f);
-int find_vertices(vertex *v, vertex **vl);
+object *create_object();
+int add_vertex(object *o, double x, double y, double z);
+int add_vertex_color(object *o, double x, double y, double z, color c);
+int add_face(object *o, int length, ...);
+int add_face_indexes(object *o, int length, int *indexes);
+vertex *get_face_vertex(object *o, face *f, int i);
+void compute_normal(object *o, face *f);
 int count_vertices(object *o);
-void update_vertices_list_from_face(object *o, face *f);
-void update_vertices_list(object *o);
 void translate_object(object *o, mfloat_t* translation);
 void transform_object(object *o, mfloat_t* transformation_matrix);
+// Capacites minimales (sans perte du contenu) / vidage sans liberation, pour
+// reconstruire la geometrie sans reallouer
+int reserve_object(object *o, int vertices, int indexes, int faces);
+void clear_object(object *o);
 void free_object(object *object);
 
+void compute_mvp(mfloat_t *mvp, mfloat_t *model, mfloat_t *camera, mfloat_t *projection);
+
+void init_orbit_camera(orbit_camera *c, mfloat_t *position, mfloat_t *target, mfloat_t fov, mfloat_t aspect);
+void orbit_camera_rotate(orbit_camera *c, mfloat_t yaw, mfloat_t pitch);
+void orbit_camera_zoom(orbit_camera *c, mfloat_t factor);
+// Deplacement de target dans le plan de l'ecran, en fraction de la distance
+void orbit_camera_pan(orbit_camera *c, mfloat_t dx, mfloat_t dy);
+// Nouvelles position, vue et vue-projection apres un changement, retourne 1
+// si elles ont ete recalculees
+int update_orbit_camera(orbit_camera *c);
+void transform_batch(mfloat_t *m, const float *x, const float *y, const float *z, int n,
+    float *tx, float *ty, float *tz);
+void transform_project_batch(mfloat_t *mvp, const float *x, const float *y, const float *z, int n,
+    int w, int h, int *sx, int *sy, float *depth, unsigned char *visible);
+
+// Projection des positions de n vertices, tableaux dans le bloc retourne
+// (a liberer avec free, NULL si l'allocation echoue)
+#define PROJECTED_VERTEX_SIZE (4 * sizeof(float) + 2 * sizeof(int) + 1)
+void *project_vertices(vertex *vertices, int n, mfloat_t *mvp, int w, int h,
+    int **sx, int **sy, float **depth, unsigned char **visible);
+// Meme projection dans le bloc o->projection, 0 s'il n'existe pas
+int project_object(object *o, mfloat_t *mvp, int w, int h,
+    int **sx, int **sy, float **depth, unsigned char **visible);
+
+point_cloud *create_point_cloud(int capacity);
+int reserve_point_cloud(point_cloud *pc, int capacity);
+int add_point(point_cloud *pc, float x, float y, float z, color c);
+void clear_point_cloud(point_cloud *pc);
+void transform_point_cloud(point_cloud *pc, mfloat_t *transformation_matrix);
+void project_point_cloud(point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int w, int h);
+void free_point_cloud(point_cloud *pc);
+
+// Vue sur length points de pc a partir de offset, sans copie : les tableaux
+// de la vue pointent dans ceux de pc, qui ne doit plus etre realloue.
+// La vue n'est pas a liberer et ne recoit pas de points.
+void point_cloud_view(point_cloud *view, point_cloud *pc, int offset, int length);
+
 light *create_light(float x, float y, float z, float i);
 void free_light(light *l);
 
@@ -84,11 +167,12 @@ void print_vec3(mfloat_t *m);
 
 
 void create_sphere(object *o, int sectors, int stack, float radius);
-void create_obj(object *o, char *filename);
+int create_obj(object *o, char *filename);
 
 
 void render_object(SDL_Renderer *r, object *o, mfloat_t *camera, mfloat_t *projection, int w, int h, int only_vertices, int vertice_size);
-void render_vertices(SDL_Renderer *r, vertex **vertices, int length, mfloat_t *camera, mfloat_t *projection, int w, int h);
+void render_point_cloud(SDL_Renderer *r, point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int w, int h, int vertice_size);
+void render_vertices(SDL_Renderer *r, vertex *vertices, int length, mfloat_t *camera, mfloat_t *projection, int w, int h);
 void render_polygon(SDL_Renderer *renderer, mfloat_t **vertices, int length,int height_max,
     int r, int g, int b, int a);
 
@@ -0,0 +1,217 @@
+#include "analysis.h"
+#include "jpeg.h"
+#include "planar.h"
+#include "kmean.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+int queue_push(ANALYSIS_QUEUE *queue, ANALYSIS_MESSAGE *message)
+{
+	int tail = SDL_AtomicGet(&queue->tail);
+	int head = SDL_AtomicGet(&queue->head);
+	if (tail - head >= ANALYSIS_QUEUE_SIZE)
+		return 0;
+
+	queue->messages[tail & (ANALYSIS_QUEUE_SIZE - 1)] = *message;
+	// le message doit etre visible avant la nouvelle fin de file
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&queue->tail, tail + 1);
+	return 1;
+}
+
+
+
+int queue_pop(ANALYSIS_QUEUE *queue, ANALYSIS_MESSAGE *message)
+{
+	int head = SDL_AtomicGet(&queue->head);
+	int tail = SDL_AtomicGet(&queue->tail);
+	if (head == tail)
+		return 0;
+
+	SDL_MemoryBarrierAcquire();
+	*message = queue->messages[head & (ANALYSIS_QUEUE_SIZE - 1)];
+	// la case n'est rendue au producteur qu'une fois lue
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&queue->head, head + 1);
+	return 1;
+}
+
+
+
+static void free_message_data(ANALYSIS_MESSAGE *message)
+{
+	if (message->type == ANALYSIS_THUMBNAIL)
+		free_image(message->data);
+	else if (message->type == ANALYSIS_COLORS)
+		free_color_lod(message->data);
+	else if (message->type == ANALYSIS_COLORS_BAND || message->type == ANALYSIS_HISTOGRAM)
+		free_colors_histogram(message->data);
+	message->data = NULL;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Publication, attend une place libre sauf si l'analyse est annulee
+// (les donnees du message sont alors liberees ici)
+//------------------------------------------------------------------------------
+static int publish(ANALYSIS *analysis, int type, int value, void *data)
+{
+	ANALYSIS_MESSAGE message = { type, value, data };
+	while (!queue_push(&analysis->queue, &message)) {
+		if (SDL_AtomicGet(&analysis->cancel)) {
+			free_message_data(&message);
+			return 0;
+		}
+		SDL_Delay(1);
+	}
+	return 1;
+}
+
+
+
+static int kmean_progress(int iter, PALETTE *palette, void *data)
+{
+	ANALYSIS *analysis = data;
+	(void)palette;
+	if (!publish(analysis, ANALYSIS_PALETTE, iter, NULL))
+		return 1;
+	return SDL_AtomicGet(&analysis->cancel);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Histogrammes par bandes d'environ un million de pixels, publies des qu'ils
+// sont comptes pour le nuage progressif. L'histogramme complet est ensuite
+// calcule en un seul tri de toutes les couleurs : fusionner chaque bande
+// dans le total recopierait tout l'histogramme a chaque bande.
+//------------------------------------------------------------------------------
+#define BAND_PIXELS	(1 << 20)
+
+static COLORS_HISTOGRAM *count_colors(ANALYSIS *analysis, PLANAR_IMAGE *image)
+{
+	int band_rows = MAX(1, BAND_PIXELS / image->width);
+
+	for (int y = 0; y < image->height; y += band_rows) {
+		if (SDL_AtomicGet(&analysis->cancel))
+			return NULL;
+		COLORS_HISTOGRAM *band = create_colors_histogram_planar_rows(image, y, MIN(image->height, y + band_rows));
+		if (!band)
+			return NULL;
+		publish(analysis, ANALYSIS_COLORS_BAND, y, band);
+	}
+	if (SDL_AtomicGet(&analysis->cancel))
+		return NULL;
+	return create_colors_histogram_planar(image);
+}
+
+
+
+static int analysis_thread(void *data)
+{
+	ANALYSIS *analysis = data;
+
+	IMAGE *image = load_pool(analysis->filename, analysis->pool);
+	if (!image) {
+		publish(analysis, ANALYSIS_FAILED, 0, NULL);
+		return 0;
+	}
+
+	float ratio_x = image->width / (float)analysis->thumbnail_width;
+	float ratio_y = image->height / (float)analysis->thumbnail_height;
+	float ratio = MAX(1.0, MAX(ratio_x, ratio_y));
+	printf("ratio %f\n", ratio);
+	// la vignette change de thread : hors pool
+	IMAGE *thumbnail = bilinear_resize(image, (int)(image->width / ratio), (int)(image->height / ratio));
+	if (thumbnail)
+		publish(analysis, ANALYSIS_THUMBNAIL, 0, thumbnail);
+
+	PLANAR_IMAGE *planar_image = pool_acquire_planar_image(analysis->pool, image->width, image->height);
+	if (planar_image)
+		convert_image_to_planar(image, planar_image);
+	free_image(image);
+	if (!planar_image) {
+		publish(analysis, ANALYSIS_FAILED, 0, NULL);
+		return 0;
+	}
+
+	COLORS_HISTOGRAM *colors = count_colors(analysis, planar_image);
+	COLOR_LOD *lod = colors ? create_color_lod(colors, analysis->threshold) : NULL;
+	if (!lod) {
+		free_colors_histogram(colors);
+		free_planar_image(planar_image);
+		publish(analysis, ANALYSIS_FAILED, 0, NULL);
+		return 0;
+	}
+	printf("Nombre de couleurs: %u\n", colors->size);
+	publish(analysis, ANALYSIS_COLORS, colors->size, lod);
+	publish(analysis, ANALYSIS_HISTOGRAM, colors->size, colors);
+
+	int iter_count = 0;
+	if (!SDL_AtomicGet(&analysis->cancel)) {
+		iter_count = guess_palette_kmean_planar_callback(planar_image, analysis->palettes, analysis->k, analysis->max_iter,
+			COLOR_SPACE_RGB, NULL, kmean_progress, analysis);
+	}
+	free_planar_image(planar_image);
+
+	publish(analysis, ANALYSIS_DONE, iter_count, NULL);
+	return 0;
+}
+
+
+
+ANALYSIS *start_analysis(char *filename, int threshold, int k, int max_iter, PALETTE *palettes,
+	int thumbnail_width, int thumbnail_height)
+{
+	ANALYSIS *analysis = calloc(1, sizeof(ANALYSIS));
+	if (!analysis)
+		return NULL;
+
+	analysis->filename = filename;
+	analysis->threshold = threshold;
+	analysis->k = k;
+	analysis->max_iter = max_iter;
+	analysis->palettes = palettes;
+	analysis->thumbnail_width = thumbnail_width;
+	analysis->thumbnail_height = thumbnail_height;
+	SDL_AtomicSet(&analysis->queue.head, 0);
+	SDL_AtomicSet(&analysis->queue.tail, 0);
+	SDL_AtomicSet(&analysis->cancel, 0);
+
+	analysis->pool = create_image_pool();
+	analysis->thread = analysis->pool ? SDL_CreateThread(analysis_thread, "analysis", analysis) : NULL;
+	if (!analysis->thread) {
+		free_image_pool(analysis->pool);
+		free(analysis);
+		return NULL;
+	}
+	return analysis;
+}
+
+
+
+int poll_analysis(ANALYSIS *analysis, ANALYSIS_MESSAGE *message)
+{
+	return queue_pop(&analysis->queue, message);
+}
+
+
+
+void stop_analysis(ANALYSIS *analysis)
+{
+	ANALYSIS_MESSAGE message;
+
+	if (!analysis)
+		return;
+
+	SDL_AtomicSet(&analysis->cancel, 1);
+	SDL_WaitThread(analysis->thread, NULL);
+	while (queue_pop(&analysis->queue, &message))
+		free_message_data(&message);
+	free_image_pool(analysis->pool);
+	free(analysis);
+}
@@ -0,0 +1,80 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <SDL2/SDL.h>
+
+#include "pixel.h"
+#include "lod.h"
+#include "pool.h"
+
+
+//------------------------------------------------------------------------------
+// Analyse de l'image dans un thread : chargement, vignette, histogrammes
+// des bandes de lignes au fil du comptage, nuage des couleurs puis une
+// palette par iteration du kmean. Les resultats sont publies dans une file
+// sans verrou a un producteur (le thread d'analyse) et un consommateur (la
+// boucle de rendu).
+//------------------------------------------------------------------------------
+#define ANALYSIS_THUMBNAIL	1	// data : IMAGE * de la vignette
+#define ANALYSIS_COLORS		2	// data : COLOR_LOD *, value : nombre de couleurs
+#define ANALYSIS_PALETTE	3	// value : iteration, palette dans palettes[value]
+#define ANALYSIS_DONE		4	// value : nombre d'iterations
+#define ANALYSIS_FAILED		5
+#define ANALYSIS_COLORS_BAND	6	// data : COLORS_HISTOGRAM * d'une bande de lignes
+#define ANALYSIS_HISTOGRAM	7	// data : COLORS_HISTOGRAM * complet, garde pour relancer le kmean
+
+// data appartient au consommateur une fois le message lu
+typedef struct ANALYSIS_MESSAGE {
+	int	type;
+	int	value;
+	void *	data;
+} ANALYSIS_MESSAGE;
+
+#define ANALYSIS_QUEUE_SIZE	256	// puissance de 2
+
+typedef struct ANALYSIS_QUEUE {
+	ANALYSIS_MESSAGE	messages[ANALYSIS_QUEUE_SIZE];
+	SDL_atomic_t		head;	// prochain message a lire
+	SDL_atomic_t		tail;	// prochaine case a ecrire
+} ANALYSIS_QUEUE;
+
+typedef struct ANALYSIS {
+	char *		filename;
+	int		threshold;
+	int		k;
+	int		max_iter;
+	int		thumbnail_width;
+	int		thumbnail_height;
+	PALETTE *	palettes;	// max_iter palettes, chacune ecrite avant sa publication
+	IMAGE_POOL *	pool;		// image chargee et image planaire, propre au thread
+	ANALYSIS_QUEUE	queue;
+	SDL_atomic_t	cancel;
+	SDL_Thread *	thread;
+} ANALYSIS;
+
+
+//------------------------------------------------------------------------------
+// File a un producteur et un consommateur, retourne 0 si pleine / vide
+//------------------------------------------------------------------------------
+int queue_push(ANALYSIS_QUEUE *queue, ANALYSIS_MESSAGE *message);
+int queue_pop(ANALYSIS_QUEUE *queue, ANALYSIS_MESSAGE *message);
+
+//------------------------------------------------------------------------------
+// Lancement du thread d'analyse de filename, palettes doit pouvoir contenir
+// max_iter palettes. La vignette tient dans thumbnail_width x thumbnail_height.
+//------------------------------------------------------------------------------
+ANALYSIS *start_analysis(char *filename, int threshold, int k, int max_iter, PALETTE *palettes,
+	int thumbnail_width, int thumbnail_height);
+
+//------------------------------------------------------------------------------
+// Message suivant sans attendre, 0 si aucun
+//------------------------------------------------------------------------------
+int poll_analysis(ANALYSIS *analysis, ANALYSIS_MESSAGE *message);
+
+//------------------------------------------------------------------------------
+// Arret du kmean en cours, attente du thread et liberation des resultats
+// non lus
+//------------------------------------------------------------------------------
+void stop_analysis(ANALYSIS *analysis);
+
+#endif
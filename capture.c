@@ -0,0 +1,241 @@
+#include "capture.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define GIF_MAX_CODE	4095
+
+
+int write_ppm(const char *filename, const Uint32 *pixels, int width, int height, int pitch)
+{
+	FILE *file = fopen(filename, "wb");
+	if (file == NULL)
+		return 0;
+
+	unsigned char *row = malloc(3 * width);
+	if (row == NULL) {
+		fclose(file);
+		return 0;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (int y = 0; y < height; y++) {
+		const Uint32 *p = pixels + y * pitch;
+		for (int x = 0; x < width; x++) {
+			row[3 * x] = (p[x] >> 16) & 0xFF;
+			row[3 * x + 1] = (p[x] >> 8) & 0xFF;
+			row[3 * x + 2] = p[x] & 0xFF;
+		}
+		fwrite(row, 3, width, file);
+	}
+
+	free(row);
+	return fclose(file) == 0;
+}
+
+
+
+static void write_short(FILE *file, int value)
+{
+	fputc(value & 0xFF, file);
+	fputc((value >> 8) & 0xFF, file);
+}
+
+
+
+GIF_WRITER *open_gif(const char *filename, int width, int height, PALETTE *palette, int delay)
+{
+	GIF_WRITER *gif = calloc(1, sizeof(GIF_WRITER));
+	if (gif == NULL)
+		return NULL;
+
+	gif->width = width;
+	gif->height = height;
+	gif->delay = delay;
+	gif->bits = 1;
+	while ((1 << gif->bits) < palette->size)
+		gif->bits++;
+	gif->code_bits = gif->bits < 2 ? 2 : gif->bits;
+	gif->children = malloc(sizeof(unsigned short) * (GIF_MAX_CODE + 1) << gif->code_bits);
+	gif->file = fopen(filename, "wb");
+	if (gif->children == NULL || gif->file == NULL) {
+		close_gif(gif);
+		return NULL;
+	}
+
+	// ecran logique avec table des couleurs globale
+	fwrite("GIF89a", 1, 6, gif->file);
+	write_short(gif->file, width);
+	write_short(gif->file, height);
+	fputc(0x80 | ((gif->bits - 1) << 4) | (gif->bits - 1), gif->file);
+	fputc(0, gif->file);
+	fputc(0, gif->file);
+	for (int i = 0; i < (1 << gif->bits); i++) {
+		for (int j = 0; j < 3; j++)
+			fputc(i < palette->size ? palette->colors[i][j] : 0, gif->file);
+	}
+
+	// animation en boucle infinie
+	fwrite("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 1, 19, gif->file);
+	return gif;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Ecriture des codes LZW de poids faible en premier, par sous-blocs de 255
+// octets au plus
+//------------------------------------------------------------------------------
+typedef struct GIF_BITS {
+	FILE *		file;
+	unsigned int	accumulator;
+	int		count;
+	unsigned char	block[255];
+	int		length;
+} GIF_BITS;
+
+static void flush_block(GIF_BITS *bits)
+{
+	if (bits->length > 0) {
+		fputc(bits->length, bits->file);
+		fwrite(bits->block, 1, bits->length, bits->file);
+		bits->length = 0;
+	}
+}
+
+
+
+static void write_code(GIF_BITS *bits, int code, int size)
+{
+	bits->accumulator |= (unsigned int)code << bits->count;
+	bits->count += size;
+	while (bits->count >= 8) {
+		bits->block[bits->length++] = bits->accumulator & 0xFF;
+		bits->accumulator >>= 8;
+		bits->count -= 8;
+		if (bits->length == 255)
+			flush_block(bits);
+	}
+}
+
+
+
+int write_gif_frame(GIF_WRITER *gif, const unsigned char *indexes)
+{
+	FILE *file = gif->file;
+	int n = gif->width * gif->height;
+	int alphabet = 1 << gif->code_bits;
+	int clear = alphabet;
+	int end = clear + 1;
+
+	// controle graphique (delai) puis descripteur de l'image entiere
+	fwrite("\x21\xF9\x04\x00", 1, 4, file);
+	write_short(file, gif->delay);
+	fwrite("\x00\x00", 1, 2, file);
+	fputc(0x2C, file);
+	write_short(file, 0);
+	write_short(file, 0);
+	write_short(file, gif->width);
+	write_short(file, gif->height);
+	fputc(0, file);
+	fputc(gif->code_bits, file);
+
+	// le fils de code par l'index c est children[code * alphabet + c], 0 si
+	// absent (les codes ajoutes sont tous > end)
+	GIF_BITS bits = { file, 0, 0, {0}, 0 };
+	int size = gif->code_bits + 1;
+	int next = end;
+	memset(gif->children, 0, sizeof(unsigned short) * (GIF_MAX_CODE + 1) << gif->code_bits);
+	write_code(&bits, clear, size);
+
+	int prefix = n > 0 ? indexes[0] : 0;
+	for (int i = 1; i < n; i++) {
+		int c = indexes[i];
+		unsigned short *child = &gif->children[prefix * alphabet + c];
+		if (*child) {
+			prefix = *child;
+			continue;
+		}
+		write_code(&bits, prefix, size);
+		*child = ++next;
+		if (next >= (1 << size))
+			size++;
+		if (next == GIF_MAX_CODE) {
+			// dictionnaire plein : on repart de zero
+			write_code(&bits, clear, size);
+			memset(gif->children, 0, sizeof(unsigned short) * (GIF_MAX_CODE + 1) << gif->code_bits);
+			size = gif->code_bits + 1;
+			next = end;
+		}
+		prefix = c;
+	}
+	write_code(&bits, prefix, size);
+	// le decodeur ajoute une entree en lisant ce dernier code
+	if (next + 1 >= (1 << size))
+		size++;
+	write_code(&bits, end, size);
+	if (bits.count > 0)
+		write_code(&bits, 0, 8 - bits.count);
+	flush_block(&bits);
+	fputc(0, file);
+
+	return !ferror(file);
+}
+
+
+
+void close_gif(GIF_WRITER *gif)
+{
+	if (gif == NULL)
+		return;
+	if (gif->file) {
+		fputc(0x3B, gif->file);
+		fclose(gif->file);
+	}
+	free(gif->children);
+	free(gif);
+}
+
+
+
+unsigned char *create_palette_lookup(PALETTE *palette)
+{
+	unsigned char *lookup = malloc(1 << 15);
+	if (lookup == NULL)
+		return NULL;
+
+	#pragma omp parallel for schedule(static)
+	for (int key = 0; key < (1 << 15); key++) {
+		// centre de la case 5 bits de chaque composante
+		int r = ((key >> 10) << 3) | 4;
+		int g = (((key >> 5) & 31) << 3) | 4;
+		int b = ((key & 31) << 3) | 4;
+		int best = 0, best_d = 1 << 30;
+		for (int i = 0; i < palette->size; i++) {
+			int dr = r - palette->colors[i][0];
+			int dg = g - palette->colors[i][1];
+			int db = b - palette->colors[i][2];
+			int d = dr * dr + dg * dg + db * db;
+			if (d < best_d) {
+				best_d = d;
+				best = i;
+			}
+		}
+		lookup[key] = best;
+	}
+	return lookup;
+}
+
+
+
+void argb_to_indexes(const Uint32 *pixels, int width, int height, int pitch,
+	const unsigned char *lookup, unsigned char *indexes)
+{
+	for (int y = 0; y < height; y++) {
+		const Uint32 *p = pixels + y * pitch;
+		unsigned char *q = indexes + y * width;
+		for (int x = 0; x < width; x++)
+			q[x] = lookup[((p[x] >> 9) & 0x7C00) | ((p[x] >> 6) & 0x03E0) | ((p[x] >> 3) & 0x001F)];
+	}
+}
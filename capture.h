@@ -0,0 +1,45 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+#include "pixel.h"
+
+
+//------------------------------------------------------------------------------
+// Enregistrement des frames rendues hors ecran (pixels ARGB8888 d'un
+// framebuffer headless) : une image PPM par frame ou un GIF anime
+//------------------------------------------------------------------------------
+int write_ppm(const char *filename, const Uint32 *pixels, int width, int height, int pitch);
+
+
+//------------------------------------------------------------------------------
+// GIF anime en boucle avec une seule palette globale (au plus 32 couleurs,
+// celle d'un quantificateur de quantize.h). Les frames sont des index dans
+// la palette, compresses en LZW.
+//------------------------------------------------------------------------------
+typedef struct GIF_WRITER {
+	FILE *		file;
+	int		width;
+	int		height;
+	int		delay;		// entre deux frames, en centiemes de seconde
+	int		bits;		// taille de la table des couleurs : 2^bits
+	unsigned short *children;	// arbre du dictionnaire LZW, 4096 x 2^code_bits
+	int		code_bits;	// taille minimale des codes LZW (>= 2)
+} GIF_WRITER;
+
+GIF_WRITER *open_gif(const char *filename, int width, int height, PALETTE *palette, int delay);
+int write_gif_frame(GIF_WRITER *gif, const unsigned char *indexes);
+void close_gif(GIF_WRITER *gif);
+
+//------------------------------------------------------------------------------
+// Table de correspondance RGB 5/5/5 -> index de la couleur la plus proche
+// de la palette (32768 entrees, a liberer avec free) et conversion d'une
+// frame ARGB en index
+//------------------------------------------------------------------------------
+unsigned char *create_palette_lookup(PALETTE *palette);
+void argb_to_indexes(const Uint32 *pixels, int width, int height, int pitch,
+	const unsigned char *lookup, unsigned char *indexes);
+
+#endif
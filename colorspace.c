@@ -0,0 +1,311 @@
+#include "colorspace.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+
+#define CBRT_LUT_SIZE	4096
+#define CBRT_LUT_MIN	(1.0f / 64.0f)
+
+// Blanc de reference D65
+#define XN	0.95047f
+#define YN	1.0f
+#define ZN	1.08883f
+
+#define LAB_EPSILON	(216.0f / 24389.0f)
+#define LAB_KAPPA	(24389.0f / 27.0f)
+
+
+static int luts_initialized = 0;
+static float linear_lut[256];
+static float cbrt_lut[CBRT_LUT_SIZE + 1];
+
+// Facteurs de ponderation de color_delta_f
+static float rgb_weights[3];
+
+
+
+//------------------------------------------------------------------------------
+// Tables calculees une seule fois :
+// - sRGB 8 bits vers lineaire [0, 1]
+// - racine cubique sur [1/64, 1] interpolee lineairement
+//------------------------------------------------------------------------------
+static void init_luts()
+{
+	if (luts_initialized)
+		return;
+
+	for (int i = 0; i < 256; i++)
+		linear_lut[i] = linear_space_f(i) / 255.0f;
+
+	for (int i = 0; i <= CBRT_LUT_SIZE; i++)
+		cbrt_lut[i] = cbrtf(CBRT_LUT_MIN + (1.0f - CBRT_LUT_MIN) * i / CBRT_LUT_SIZE);
+
+	rgb_weights[0] = sqrtf(30);
+	rgb_weights[1] = sqrtf(59);
+	rgb_weights[2] = sqrtf(11);
+
+	luts_initialized = 1;
+}
+
+
+
+static inline float fast_cbrt(float t)
+{
+	if (t < CBRT_LUT_MIN)
+		return cbrtf(t);
+	if (t >= 1.0f)
+		return t == 1.0f ? 1.0f : cbrtf(t);
+
+	float pos = (t - CBRT_LUT_MIN) * (CBRT_LUT_SIZE / (1.0f - CBRT_LUT_MIN));
+	int i = (int)pos;
+	float frac = pos - i;
+
+	return cbrt_lut[i] + (cbrt_lut[i + 1] - cbrt_lut[i]) * frac;
+}
+
+
+
+static inline float lab_f(float t)
+{
+	return t > LAB_EPSILON ? fast_cbrt(t) : (LAB_KAPPA * t + 16.0f) / 116.0f;
+}
+
+
+
+static inline float lab_f_inv(float f)
+{
+	float f3 = f * f * f;
+
+	return f3 > LAB_EPSILON ? f3 : (116.0f * f - 16.0f) / LAB_KAPPA;
+}
+
+
+
+static inline unsigned char linear_to_byte(float x)
+{
+	x = x < 0 ? 0 : (x > 1 ? 1 : x);
+	return (unsigned char)lroundf(rgb_space_f(x * 255.0f));
+}
+
+
+
+static inline void convert_color(int space, unsigned char r, unsigned char g, unsigned char b, float *c0, float *c1, float *c2)
+{
+	float lr, lg, lb;
+
+	if (space == COLOR_SPACE_RGB) {
+		*c0 = r * rgb_weights[0];
+		*c1 = g * rgb_weights[1];
+		*c2 = b * rgb_weights[2];
+		return;
+	}
+
+	lr = linear_lut[r];
+	lg = linear_lut[g];
+	lb = linear_lut[b];
+
+	if (space == COLOR_SPACE_LAB) {
+		float fx = lab_f((0.4124564f * lr + 0.3575761f * lg + 0.1804375f * lb) / XN);
+		float fy = lab_f((0.2126729f * lr + 0.7151522f * lg + 0.0721750f * lb) / YN);
+		float fz = lab_f((0.0193339f * lr + 0.1191920f * lg + 0.9503041f * lb) / ZN);
+
+		*c0 = 116.0f * fy - 16.0f;
+		*c1 = 500.0f * (fx - fy);
+		*c2 = 200.0f * (fy - fz);
+	} else {
+		float l = fast_cbrt(0.4122214708f * lr + 0.5363325363f * lg + 0.0514459929f * lb);
+		float m = fast_cbrt(0.2119034982f * lr + 0.6806995451f * lg + 0.1073969566f * lb);
+		float s = fast_cbrt(0.0883024619f * lr + 0.2817188376f * lg + 0.6299787005f * lb);
+
+		*c0 = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+		*c1 = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+		*c2 = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+	}
+}
+
+
+
+void rgb_to_color_space(int space, unsigned char r, unsigned char g, unsigned char b, float out[3])
+{
+	init_luts();
+	convert_color(space, r, g, b, &out[0], &out[1], &out[2]);
+}
+
+
+
+void color_space_to_rgb(int space, const float in[3], unsigned char rgb[3])
+{
+	float lr, lg, lb;
+
+	init_luts();
+
+	if (space == COLOR_SPACE_RGB) {
+		for (int i = 0; i < 3; i++) {
+			float v = in[i] / rgb_weights[i];
+			rgb[i] = v < 0 ? 0 : (v > 255 ? 255 : (unsigned char)lroundf(v));
+		}
+		return;
+	}
+
+	if (space == COLOR_SPACE_LAB) {
+		float fy = (in[0] + 16.0f) / 116.0f;
+		float x = lab_f_inv(fy + in[1] / 500.0f) * XN;
+		float y = lab_f_inv(fy) * YN;
+		float z = lab_f_inv(fy - in[2] / 200.0f) * ZN;
+
+		lr = 3.2404542f * x - 1.5371385f * y - 0.4985314f * z;
+		lg = -0.9692660f * x + 1.8760108f * y + 0.0415560f * z;
+		lb = 0.0556434f * x - 0.2040259f * y + 1.0572252f * z;
+	} else {
+		float l = in[0] + 0.3963377774f * in[1] + 0.2158037573f * in[2];
+		float m = in[0] - 0.1055613458f * in[1] - 0.0638541728f * in[2];
+		float s = in[0] - 0.0894841775f * in[1] - 1.2914855480f * in[2];
+
+		l = l * l * l;
+		m = m * m * m;
+		s = s * s * s;
+
+		lr = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+		lg = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+		lb = -0.0041960350f * l - 0.7034186147f * m + 1.7076147010f * s;
+	}
+
+	rgb[0] = linear_to_byte(lr);
+	rgb[1] = linear_to_byte(lg);
+	rgb[2] = linear_to_byte(lb);
+}
+
+
+
+static COLOR_PLANES *alloc_color_planes(int size, int space)
+{
+	COLOR_PLANES *planes = (COLOR_PLANES *)malloc(sizeof(COLOR_PLANES));
+
+	if (planes == NULL) {
+		fprintf(stderr, "Impossible de créer la structure COLOR_PLANES\n");
+		return NULL;
+	}
+
+	// Chaque plan commence sur une frontiere de PLANAR_ALIGN octets
+	int plane_size = (size + PLANAR_ALIGN / sizeof(float) - 1) / (PLANAR_ALIGN / sizeof(float)) * (PLANAR_ALIGN / sizeof(float));
+	float *buffer = (float *)aligned_malloc(sizeof(float) * 3 * plane_size, PLANAR_ALIGN);
+
+	if (buffer == NULL) {
+		fprintf(stderr, "Impossible de créer les plans de couleur\n");
+		free(planes);
+		return NULL;
+	}
+
+	init_luts();
+
+	planes->size = size;
+	planes->space = space;
+	planes->c0 = buffer;
+	planes->c1 = buffer + plane_size;
+	planes->c2 = buffer + 2 * plane_size;
+
+	return planes;
+}
+
+
+
+COLOR_PLANES *create_color_planes(IMAGE *image, int space)
+{
+	int size = image->width * image->height;
+	COLOR_PLANES *planes = alloc_color_planes(size, space);
+
+	if (planes == NULL)
+		return NULL;
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < size; i++) {
+		PIXEL p = image->pixels[i];
+		convert_color(space, p.r, p.g, p.b, &planes->c0[i], &planes->c1[i], &planes->c2[i]);
+	}
+
+	return planes;
+}
+
+
+
+COLOR_PLANES *create_color_planes_planar(PLANAR_IMAGE *image, int space)
+{
+	int w = image->width;
+	COLOR_PLANES *planes = alloc_color_planes(w * image->height, space);
+
+	if (planes == NULL)
+		return NULL;
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < image->height; y++) {
+		const unsigned char *r = image->r + y * image->stride;
+		const unsigned char *g = image->g + y * image->stride;
+		const unsigned char *b = image->b + y * image->stride;
+
+		for (int x = 0; x < w; x++)
+			convert_color(space, r[x], g[x], b[x], &planes->c0[y * w + x], &planes->c1[y * w + x], &planes->c2[y * w + x]);
+	}
+
+	return planes;
+}
+
+
+
+void free_color_planes(COLOR_PLANES *planes)
+{
+	if (planes) {
+		aligned_free(planes->c0);
+		free(planes);
+	}
+}
+
+
+
+void convert_palette_to_space(PALETTE *palette, int space, float colors[][3])
+{
+	for (int i = 0; i < palette->size; i++)
+		rgb_to_color_space(space, palette->colors[i][0], palette->colors[i][1], palette->colors[i][2], colors[i]);
+}
+
+
+
+int find_closest_color_index_space(const float c[3], float colors[][3], int size)
+{
+	float d, diff = FLT_MAX;
+	int plt = 0;
+
+	for (int i = 0; i < size; i++) {
+		d = color_space_delta(c, colors[i]);
+		if (d < diff) {
+			plt = i;
+			diff = d;
+		}
+	}
+	return plt;
+}
+
+
+
+unsigned char *create_pixels_array_planes(COLOR_PLANES *planes, PALETTE *palette)
+{
+	float colors[32][3];
+	unsigned char *pixels = malloc(sizeof(unsigned char) * planes->size);
+
+	if (!pixels) {
+		printf("Pas assez de memoire\n");
+		return NULL;
+	}
+
+	convert_palette_to_space(palette, planes->space, colors);
+
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < planes->size; i++) {
+		float c[3] = { planes->c0[i], planes->c1[i], planes->c2[i] };
+		pixels[i] = find_closest_color_index_space(c, colors, palette->size);
+	}
+	return pixels;
+}
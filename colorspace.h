@@ -0,0 +1,74 @@
+#ifndef COLORSPACE_H
+#define COLORSPACE_H
+
+#include "pixel.h"
+#include "planar.h"
+
+
+//------------------------------------------------------------------------------
+// Espaces de couleur utilises pour le calcul des distances
+// COLOR_SPACE_RGB : RGB pondere 30/59/11 (identique a color_delta_f)
+// COLOR_SPACE_LAB : CIELAB D65
+// COLOR_SPACE_OKLAB : Oklab
+//------------------------------------------------------------------------------
+#define COLOR_SPACE_RGB		0
+#define COLOR_SPACE_LAB		1
+#define COLOR_SPACE_OKLAB	2
+
+
+//------------------------------------------------------------------------------
+// Image convertie une seule fois dans un espace de couleur
+// Les 3 composantes sont stockees en plans separes (une seule allocation)
+//------------------------------------------------------------------------------
+struct COLOR_PLANES_STRUCT {
+	int	size;
+	int	space;
+	float * c0;
+	float * c1;
+	float * c2;
+};
+typedef struct COLOR_PLANES_STRUCT COLOR_PLANES;
+
+
+//------------------------------------------------------------------------------
+// Conversion d'une couleur RGB vers l'espace et inversement
+//------------------------------------------------------------------------------
+void rgb_to_color_space(int space, unsigned char r, unsigned char g, unsigned char b, float out[3]);
+void color_space_to_rgb(int space, const float in[3], unsigned char rgb[3]);
+
+//------------------------------------------------------------------------------
+// Distance (au carre) entre 2 couleurs exprimees dans le meme espace
+//------------------------------------------------------------------------------
+static inline float color_space_delta(const float c1[3], const float c2[3])
+{
+	float d0 = c1[0] - c2[0];
+	float d1 = c1[1] - c2[1];
+	float d2 = c1[2] - c2[2];
+
+	return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+//------------------------------------------------------------------------------
+// Conversion d'une image dans l'espace de couleur
+// A l'appelant de liberer la memoire avec free_color_planes
+//------------------------------------------------------------------------------
+COLOR_PLANES *create_color_planes(IMAGE *image, int space);
+COLOR_PLANES *create_color_planes_planar(PLANAR_IMAGE *image, int space);
+void free_color_planes(COLOR_PLANES *planes);
+
+//------------------------------------------------------------------------------
+// Conversion d'une palette dans l'espace de couleur
+//------------------------------------------------------------------------------
+void convert_palette_to_space(PALETTE *palette, int space, float colors[][3]);
+
+//------------------------------------------------------------------------------
+// Retrouve l'index de la couleur la plus proche parmi size couleurs
+//------------------------------------------------------------------------------
+int find_closest_color_index_space(const float c[3], float colors[][3], int size);
+
+//------------------------------------------------------------------------------
+// Creation d'un tableau de pixels a partir d'une image deja convertie
+//------------------------------------------------------------------------------
+unsigned char *create_pixels_array_planes(COLOR_PLANES *planes, PALETTE *palette);
+
+#endif
@@ -4,6 +4,7 @@
 #include "log.h"
 #include "pixel.h"
 #include "jpeg.h"
+#include "pool.h"
 
 
 
@@ -15,7 +16,9 @@
 
 void free_image(IMAGE *image)
 {
-	if (image) {
+	if (image && image->pool) {
+		pool_release_image(image);
+	} else if (image) {
 		if (image->pixels)
 			free(image->pixels);
 		free(image);
@@ -25,6 +28,13 @@ void free_image(IMAGE *image)
 
 
 IMAGE *load(char *filename)
+{
+	return load_pool(filename, NULL);
+}
+
+
+
+IMAGE *load_pool(char *filename, IMAGE_POOL *pool)
 {
 	/* these are standard libjpeg structures for reading(decompression) */
 	struct jpeg_decompress_struct cinfo;
@@ -59,8 +69,16 @@ IMAGE *load(char *filename)
 	/* now actually read the jpeg into the raw buffer */
 	row_pointer[0] = (unsigned char *)malloc(cinfo.output_width * cinfo.num_components);
 
-	IMAGE *image = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * cinfo.image_width * cinfo.image_height);
+	IMAGE *image = pool ? pool_acquire_image(pool, cinfo.output_width, cinfo.output_height)
+			    : alloc_image(cinfo.output_width, cinfo.output_height);
+
+	if (image == NULL) {
+		jpeg_destroy_decompress(&cinfo);
+		free(row_pointer[0]);
+		fclose(infile);
+		return NULL;
+	}
+	PIXEL *pixels = image->pixels;
 
 	/* read one scan line at a time */
 	while (cinfo.output_scanline < cinfo.image_height) {
@@ -80,9 +98,5 @@ IMAGE *load(char *filename)
 	fclose(infile);
 
 
-	image->width = cinfo.output_width;
-	image->height = cinfo.output_height;
-	image->pixels = pixels;
-
 	return image;
 }
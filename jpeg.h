@@ -11,6 +11,11 @@
 //------------------------------------------------------------------------------
 IMAGE *load(char *filename);
 
+//------------------------------------------------------------------------------
+// Comme load, mais les pixels proviennent du pool (hors pool si pool est NULL)
+//------------------------------------------------------------------------------
+IMAGE *load_pool(char *filename, struct IMAGE_POOL_STRUCT *pool);
+
 //------------------------------------------------------------------------------
 // libere la memoire allouee pointee par *image
 //------------------------------------------------------------------------------
@@ -14,6 +14,12 @@
 #include "pixel.h"
 #include "jpeg.h"
 #include "kmean.h"
+#include "planar.h"
+#include "raster.h"
+#include "lod.h"
+#include "analysis.h"
+#include "capture.h"
+#include "quantize.h"
 
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -21,31 +27,80 @@
 SDL_Window *window;
 SDL_Surface *screen;
 SDL_Renderer *renderer;
-SDL_Texture *image_texture;
+SDL_Texture *image_texture = NULL;
+FRAMEBUFFER *framebuffer;
 
 
 const int w = 640;
 const int h = 640;
-const int k = 8;
+int k = 8;			// nombre de couleurs de la palette, change avec * et /
+#define K_MAX 32
 const int max_iter = 100;
-int iter_result;
-
-
-object *colors_object;
+int iter_result = 0;
+int analysis_done = 0;
+ANALYSIS *analysis = NULL;
+
+
+COLOR_LOD *colors_lod = NULL;
+point_cloud *colors_cloud = NULL;	// niveau de colors_lod affiche
+int colors_level = 0;
+int threshold = 20;			// pixels minimum d'un point du nuage des couleurs, PgUp / PgDn
+COLOR_STREAM *colors_stream = NULL;	// nuage partiel tant que colors_lod n'est pas pret
+#define STREAM_MERGE_PER_FRAME	65536
+const int point_budget = 100000;
 object *cube_object;
-object *palette_object = NULL;
+point_cloud *palette_cloud = NULL;	// palette affichee : palette_view ou live_cloud
+point_cloud *palettes_cloud = NULL;	// les palettes de toutes les iterations a la suite
+point_cloud palette_view;		// vue sur une iteration de palettes_cloud
+point_cloud *live_cloud = NULL;		// palette du dernier changement de k
+int palettes_k = 0;			// couleurs par palette dans palettes_cloud
+int show_trajectories = 0;		// trajets des centroides sur toutes les iterations, touche t
 
 int current_palette_display = 0;
 
-IMAGE *the_image = NULL;
 IMAGE *small_image = NULL;
 PALETTE *k_palettes;
 
+// Kmean relance sur l'histogramme garde quand k change, centroides dans
+// l'espace COLOR_SPACE_RGB
+COLORS_HISTOGRAM *colors_histogram = NULL;
+float centroids[K_MAX + 1][3];
+unsigned long long cluster_counts[K_MAX + 1];
+PALETTE live_palette;
+
 mfloat_t angle_step = 0.2;
 mfloat_t current_angle = 0.0;
 
+// Parties a refaire a la prochaine frame, rien n'est redessine sans elles
+#define DIRTY_TEXT	1	// textes et vignette : recopie de la derniere frame
+#define DIRTY_PALETTE	2	// palette ou trajectoires a reprojeter
+#define DIRTY_SCENE	4	// rotation, nuage ou seuil : tout reprojeter
+#define IDLE_WAIT_MS		500	// attente d'un evenement, analyse terminee
+#define ANALYSIS_WAIT_MS	10	// attente pendant l'analyse, pour lire ses messages
+int dirty = DIRTY_SCENE | DIRTY_PALETTE | DIRTY_TEXT;
+int paused = 0;			// rotation arretee, touche espace
+
 char colors_inf[256];
 char k_mean_palette_iteration[256];
+char frame_inf[256];
+
+// Mode benchmark : nombre de frames a enchainer sans vsync ni pause
+// (0 = mode interactif)
+int benchmark_frames = 0;
+
+//------------------------------------------------------------------------------
+// Temps d'une frame en ms : projection, rasterisation, copie + present
+//------------------------------------------------------------------------------
+typedef struct FRAME_STATS {
+	int frames;
+	double transform;
+	double render;
+	double present;
+	double total;
+	double min_total;
+	double max_total;
+	double avg_total;	// moyenne glissante pour l'overlay
+} FRAME_STATS;
 
 //------------------------------------------------------------------------------
 // Utils pour le log
@@ -65,7 +120,7 @@ static void end_the_log()
 
 void init() {
 
-	cube_object = create_object(0);
+	cube_object = create_object();
 	create_obj(cube_object, "cube.obj");
 	
 	mfloat_t vec_position[MAT3_SIZE];
@@ -85,8 +140,10 @@ int create_window()
 				  SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
 				  w, h,
 				  0);
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-	return 1;
+	renderer = SDL_CreateRenderer(window, -1,
+		benchmark_frames > 0 ? SDL_RENDERER_ACCELERATED : SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	framebuffer = create_framebuffer(renderer, w, h);
+	return framebuffer != NULL;
 }
 
 
@@ -101,88 +158,262 @@ int destroy_window()
 
 
 
-SDL_Texture *create_texture_from_image(PIXEL *image_pixels, int width, int height)
+//------------------------------------------------------------------------------
+// Copie des pixels dans une texture de meme taille creee par
+// create_texture_from_image : RGB24 directement depuis le tableau de PIXEL,
+// ARGB8888 par expansion ligne a ligne dans la texture verrouillee
+//------------------------------------------------------------------------------
+int update_texture_from_image(SDL_Texture *texture, PIXEL *image_pixels, int width, int height)
 {
+	Uint32 format;
 	int pitch;
 	uint8_t *pixels;
-	uint8_t *p;
-
-	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height);
-	SDL_PixelFormat *format = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
-	SDL_LockTexture(texture, NULL, (void **)&pixels, &pitch);
-
-	for(int y = 0; y < height; y++) {
-		Uint32 *p = (Uint32 *)(pixels + pitch*y);
-		for(int x = 0; x < width; x++) {
-			*(p+x) = SDL_MapRGBA(format, 
-				(image_pixels+(y*width)+x)->r, 
-				(image_pixels+(y*width)+x)->g, 
-				(image_pixels+(y*width)+x)->b, 
-				255);
-		}
-	}
 
+	SDL_QueryTexture(texture, &format, NULL, NULL, NULL);
+	if (format == SDL_PIXELFORMAT_RGB24)
+		return SDL_UpdateTexture(texture, NULL, image_pixels, width * sizeof(PIXEL)) == 0;
+
+	if (SDL_LockTexture(texture, NULL, (void **)&pixels, &pitch) != 0)
+		return 0;
+	for (int y = 0; y < height; y++)
+		pixels_to_argb(image_pixels + y * width, (unsigned int *)(pixels + pitch * y), width);
 	SDL_UnlockTexture(texture);
-	SDL_FreeFormat(format);
-	return texture;
+	return 1;
 }
 
 
 
-void update_palette(int idx) {
-	int r, g, b;
-	double x_coord, y_coord, z_coord;
-	color c;
+SDL_Texture *create_texture_from_image(PIXEL *image_pixels, int width, int height)
+{
+	SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (!texture)
+		texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (texture && !update_texture_from_image(texture, image_pixels, width, height)) {
+		SDL_DestroyTexture(texture);
+		texture = NULL;
+	}
+	return texture;
+}
+
+
 
-	if (palette_object != NULL) {
-		free_object(palette_object);
+void add_palette_points(point_cloud *pc, PALETTE *palette) {
+	for (int i = 0; i < palette->size; i++) {
+		unsigned char *rgb = palette->colors[i];
+		color c = { rgb[0], rgb[1], rgb[2] };
+		add_point(pc, rgb[0] / 128.0 - 1.0, rgb[1] / 128.0 - 1.0, rgb[2] / 128.0 - 1.0, c);
 	}
-	palette_object = create_object(0);
-
-	for (int i = 0; i < k_palettes[current_palette_display].size; i++) {
-		r = k_palettes[current_palette_display].colors[i][0];
-		g = k_palettes[current_palette_display].colors[i][1];
-		b = k_palettes[current_palette_display].colors[i][2];
-		x_coord = r / 128.0 - 1.0;
-		y_coord = g / 128.0 - 1.0;
-		z_coord = b / 128.0 - 1.0;
-		c.r = r;
-		c.g = g;
-		c.b = b;
-		vertex *v = create_vertex_color(x_coord, y_coord, z_coord, c);
-		face *f = create_face(1, v);
-		add_face_to_object(palette_object, f);
+}
+
+
+
+// Le nouveau nuage affiche garde la rotation de l'ancien
+void show_palette_cloud(point_cloud *pc) {
+	memcpy(pc->model, palette_cloud->model, sizeof(pc->model));
+	palette_cloud = pc;
+	dirty |= DIRTY_PALETTE | DIRTY_TEXT;
+}
+
+
+
+// Selection de la palette d'une iteration : un decalage dans palettes_cloud
+void show_palette(int idx) {
+	mfloat_t model[MAT4_SIZE];
+	memcpy(model, palette_cloud->model, sizeof(model));
+	point_cloud_view(&palette_view, palettes_cloud, idx * palettes_k, k_palettes[idx].size);
+	memcpy(palette_view.model, model, sizeof(model));
+	palette_cloud = &palette_view;
+	dirty |= DIRTY_PALETTE | DIRTY_TEXT;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Evenement suivant : sans rien a redessiner, attente au lieu de tourner
+//------------------------------------------------------------------------------
+static int next_event(SDL_Event *event)
+{
+	if (dirty || !paused || benchmark_frames > 0)
+		return SDL_PollEvent(event);
+	return SDL_WaitEventTimeout(event, analysis_done ? IDLE_WAIT_MS : ANALYSIS_WAIT_MS);
+}
+
+
+
+static double elapsed_ms(Uint64 from, Uint64 to)
+{
+	return (to - from) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+
+static void print_frame_stats(FRAME_STATS *stats)
+{
+	if (stats->frames == 0)
+		return;
+	printf("%d frames, %.1f fps\n", stats->frames, stats->frames * 1000.0 / stats->total);
+	printf("frame: moy %.3f ms  min %.3f ms  max %.3f ms\n",
+		stats->total / stats->frames, stats->min_total, stats->max_total);
+	printf("transform %.3f ms  render %.3f ms  present %.3f ms\n",
+		stats->transform / stats->frames, stats->render / stats->frames, stats->present / stats->frames);
+	printf("points: %d\n", (colors_cloud ? colors_cloud->length : 0) + palette_cloud->length);
+}
+
+
+//------------------------------------------------------------------------------
+// Nouveau seuil : seule la longueur du prefixe affiche du niveau 0 change
+//------------------------------------------------------------------------------
+static void change_threshold(int new_threshold)
+{
+	threshold = new_threshold < 1 ? 1 : new_threshold;
+	if (!colors_lod)
+		return;
+	dirty |= DIRTY_SCENE | DIRTY_TEXT;
+	int shown = set_color_lod_threshold(colors_lod, threshold);
+	sprintf(colors_inf, "%d couleurs affichees sur %d au total (seuil %d)", shown, colors_lod->colors, threshold);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Nouveau k : un centroide de plus ou de moins a partir des centroides
+// courants puis kmean pondere sur l'histogramme, sans repasser par l'image
+//------------------------------------------------------------------------------
+static void change_k(int new_k)
+{
+	if (!analysis_done || !colors_histogram || new_k < 2 || new_k > K_MAX || new_k == k)
+		return;
+
+	Uint64 t_start = SDL_GetPerformanceCounter();
+	if (new_k > k)
+		kmean_split_largest(colors_histogram, centroids, cluster_counts, k);
+	else
+		kmean_merge_closest(centroids, cluster_counts, k);
+	k = new_k;
+	int iters = kmean_histogram(colors_histogram, centroids, cluster_counts, k, max_iter);
+
+	for (int i = 0; i < k; i++)
+		color_space_to_rgb(COLOR_SPACE_RGB, centroids[i], live_palette.colors[i]);
+	live_palette.size = k;
+	clear_point_cloud(live_cloud);
+	add_palette_points(live_cloud, &live_palette);
+	show_palette_cloud(live_cloud);
+	sprintf(k_mean_palette_iteration, "k = %d : %d iterations en %.1f ms  (* /)",
+		k, iters, elapsed_ms(t_start, SDL_GetPerformanceCounter()));
+}
+
+
+
+//------------------------------------------------------------------------------
+// Resultats publies par le thread d'analyse depuis la derniere frame
+// Retourne 0 si l'analyse a echoue
+//------------------------------------------------------------------------------
+static int handle_analysis()
+{
+	ANALYSIS_MESSAGE message;
+
+	while (poll_analysis(analysis, &message)) {
+		switch (message.type) {
+			case ANALYSIS_THUMBNAIL:
+				small_image = message.data;
+				if (renderer)
+					image_texture = create_texture_from_image(small_image->pixels, small_image->width, small_image->height);
+				dirty |= DIRTY_TEXT;
+				break;
+			case ANALYSIS_COLORS_BAND:
+				if (!colors_stream || !add_color_stream_band(colors_stream, message.data))
+					free_colors_histogram(message.data);
+				break;
+			case ANALYSIS_COLORS:
+				free_color_stream(colors_stream);
+				colors_stream = NULL;
+				colors_lod = message.data;
+				colors_cloud = colors_lod->clouds[0];
+				printf("couleurs affichees: %d\n", colors_cloud->length);
+				sprintf(colors_inf, "%d couleurs affichees sur %d au total (seuil %d)", colors_cloud->length, message.value, threshold);
+				dirty |= DIRTY_SCENE | DIRTY_TEXT;
+				break;
+			case ANALYSIS_HISTOGRAM:
+				colors_histogram = message.data;
+				break;
+			case ANALYSIS_PALETTE:
+				iter_result = message.value + 1;
+				current_palette_display = message.value;
+				sprintf(k_mean_palette_iteration, "k-mean iteration: %d  (en cours)", iter_result);
+				// les palettes arrivent dans l'ordre, une seule fois chacune
+				add_palette_points(palettes_cloud, &k_palettes[current_palette_display]);
+				show_palette(current_palette_display);
+				break;
+			case ANALYSIS_DONE:
+				analysis_done = 1;
+				iter_result = message.value;
+				current_palette_display = iter_result - 1;
+				sprintf(k_mean_palette_iteration, "k-mean iteration: %d/%d  (+/-)", current_palette_display + 1, iter_result);
+				// point de depart des kmean suivants : la derniere palette
+				if (colors_histogram && iter_result > 0) {
+					for (int i = 0; i < k; i++) {
+						unsigned char *rgb = k_palettes[current_palette_display].colors[i];
+						rgb_to_color_space(COLOR_SPACE_RGB, rgb[0], rgb[1], rgb[2], centroids[i]);
+					}
+					kmean_histogram(colors_histogram, centroids, cluster_counts, k, 1);
+				}
+				fflush(stdout);
+				dirty |= DIRTY_TEXT;
+				break;
+			case ANALYSIS_FAILED:
+				printf("Analyse de l'image impossible\n");
+				return 0;
+		}
 	}
+	return 1;
+}
+
+
+void default_camera(orbit_camera *camera)
+{
+	mfloat_t position[VEC3_SIZE];
+	mfloat_t target[VEC3_SIZE];
+	init_orbit_camera(camera, vec3(position, 0.0, 0.5, 3.0), vec3(target, 0.0, 0.0, 0.0),
+		to_radians(90.0), (mfloat_t)w / h);
+}
+
+
+
+void free_scene()
+{
+	stop_analysis(analysis);
+	analysis = NULL;
+
+	free_object(cube_object);
+	free_color_stream(colors_stream);
+	free_color_lod(colors_lod);
+	free_colors_histogram(colors_histogram);
+	free_point_cloud(palettes_cloud);
+	free_point_cloud(live_cloud);
 }
 
 
+
 int message_loop()
 {
+	FRAME_STATS stats = {0};
+	stats.min_total = 1e30;
 
 	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
 	SDL_RenderClear(renderer);
 
-	mfloat_t position[VEC3_SIZE];
-	mfloat_t target[VEC3_SIZE];
-	mfloat_t up[VEC3_SIZE];
-	mfloat_t view[MAT4_SIZE];
-	mat4_look_at(view,
-		vec3(position, 0.0, 0.5, 3.0),
-		vec3(target, 0.0, 0.0, 0),
-		vec3(up, 0.0, 1.0, 0.0));
-
-	mfloat_t perspective[MAT4_SIZE];
-	mat4_perspective(perspective, to_radians(90.0), 1, 0.1, 100.0);
-	
-	mfloat_t mat_y_rotation_cube[MAT4_SIZE];
-	mat4_identity(mat_y_rotation_cube);
-	mat4_rotation_y(mat_y_rotation_cube, to_radians(0.2));
-
+	// souris : bouton gauche pour tourner, droit ou milieu pour deplacer,
+	// molette pour la distance, touche r pour revenir a la vue de depart
+	orbit_camera camera;
+	default_camera(&camera);
+	mfloat_t *view_projection = camera.view_projection;
 
 	int exit = 0;
 	while (!exit) {
+		if (!handle_analysis())
+			break;
+
 		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
+		for (int has_event = next_event(&event); has_event; has_event = SDL_PollEvent(&event)) {
 
 			if (event.type == SDL_QUIT) {
 				exit = 1;
@@ -194,91 +425,371 @@ int message_loop()
 						exit = 1;
 					}
 
-					if (event.key.keysym.sym == SDLK_KP_PLUS) {
+					if (event.key.keysym.sym == SDLK_KP_PLUS && iter_result > 0) {
 						current_palette_display = (current_palette_display >= iter_result - 1? iter_result - 1 : ++current_palette_display);
 						sprintf(k_mean_palette_iteration, "k-mean iteration: %d/%d  (+/-)", current_palette_display + 1, iter_result);
-						update_palette(current_palette_display);
-
-						mfloat_t mat_y[MAT4_SIZE];
-						mat4_identity(mat_y);
-						mat4_rotation_y(mat_y, to_radians(current_angle));
-						transform_object(palette_object, mat_y);
+						show_palette(current_palette_display);
 					}
 
-					if (event.key.keysym.sym == SDLK_KP_MINUS) {
+					if (event.key.keysym.sym == SDLK_KP_MINUS && iter_result > 0) {
 						current_palette_display = (current_palette_display == 0 ? 0 : current_palette_display--);
 						current_palette_display = (current_palette_display <= 0? 0 : --current_palette_display);
 						sprintf(k_mean_palette_iteration, "k-mean iteration: %d/%d  (+/-)", current_palette_display + 1, iter_result);
-						update_palette(current_palette_display);
+						show_palette(current_palette_display);
+					}
 
-						mfloat_t mat_y[MAT4_SIZE];
-						mat4_identity(mat_y);
-						mat4_rotation_y(mat_y, to_radians(current_angle));
-						transform_object(palette_object, mat_y);
+					if (event.key.keysym.sym == SDLK_SPACE) {
+						paused = !paused;
+						dirty |= DIRTY_SCENE | DIRTY_PALETTE;
 					}
+					if (event.key.keysym.sym == SDLK_r)
+						default_camera(&camera);
 
+					if (event.key.keysym.sym == SDLK_t) {
+						show_trajectories = !show_trajectories;
+						dirty |= DIRTY_PALETTE;
+					}
+
+					if (event.key.keysym.sym == SDLK_PAGEUP)
+						change_threshold(threshold + 1 + threshold / 4);
+					if (event.key.keysym.sym == SDLK_PAGEDOWN)
+						change_threshold(threshold - 1 - threshold / 5);
+
+					if (event.key.keysym.sym == SDLK_KP_MULTIPLY)
+						change_k(k + 1);
+					if (event.key.keysym.sym == SDLK_KP_DIVIDE)
+						change_k(k - 1);
+
+					break;
+				case SDL_MOUSEMOTION:
+					if (event.motion.state & SDL_BUTTON_LMASK)
+						orbit_camera_rotate(&camera, -0.01 * event.motion.xrel, 0.01 * event.motion.yrel);
+					else if (event.motion.state & (SDL_BUTTON_RMASK | SDL_BUTTON_MMASK))
+						orbit_camera_pan(&camera, -(mfloat_t)event.motion.xrel / h, (mfloat_t)event.motion.yrel / h);
+					break;
+				case SDL_MOUSEWHEEL:
+					orbit_camera_zoom(&camera, pow(0.9, event.wheel.y));
+					break;
+				case SDL_WINDOWEVENT:
+					dirty |= DIRTY_TEXT;
 					break;
 				default:
 					break;
 				}
 		}
+
+		// matrices recalculees seulement apres un mouvement de la camera
+		if (update_orbit_camera(&camera))
+			dirty |= DIRTY_SCENE | DIRTY_PALETTE;
+
+		// une part des bandes comptees par frame pour ne pas bloquer l'affichage
+		if (colors_stream && merge_color_stream(colors_stream, STREAM_MERGE_PER_FRAME) > 0) {
+			sprintf(colors_inf, "%d couleurs affichees sur %d (comptage en cours)",
+				colors_stream->cloud->length, colors_stream->colors);
+			dirty |= DIRTY_SCENE | DIRTY_TEXT;
+		}
+
+		// la rotation redessine toute la scene a chaque tour de boucle
+		if (!paused) {
+			current_angle += 0.2;
+			mat4_rotation_y(cube_object->model, to_radians(current_angle));
+			if (colors_lod)
+				mat4_rotation_y(colors_lod->model, to_radians(current_angle));
+			else if (colors_stream)
+				mat4_rotation_y(colors_stream->cloud->model, to_radians(current_angle));
+			mat4_rotation_y(palette_cloud->model, to_radians(current_angle));
+			dirty |= DIRTY_SCENE | DIRTY_PALETTE;
+		}
+
+		if (!dirty)
+			continue;
+		int redraw = dirty & (DIRTY_SCENE | DIRTY_PALETTE);
+
+		Uint64 t_start = SDL_GetPerformanceCounter();
+
+		// le nuage des couleurs garde sa projection si seule la palette change
+		if (dirty & DIRTY_SCENE) {
+			if (colors_lod) {
+				colors_level = select_color_lod(colors_lod, camera.distance, point_budget);
+				colors_cloud = colors_lod->clouds[colors_level];
+				project_point_cloud(colors_cloud, view_projection, NULL, w, h);
+			} else if (colors_stream) {
+				colors_cloud = colors_stream->cloud;
+				project_point_cloud(colors_cloud, view_projection, NULL, w, h);
+			}
+		}
+		// toutes les iterations en une projection, dans la rotation de la palette
+		int trajectory_points = show_trajectories ? palettes_cloud->length / palettes_k : 0;
+		if (redraw) {
+			project_point_cloud(palette_cloud, view_projection, NULL, w, h);
+			if (trajectory_points > 1) {
+				memcpy(palettes_cloud->model, palette_cloud->model, sizeof(palettes_cloud->model));
+				project_point_cloud(palettes_cloud, view_projection, NULL, w, h);
+			}
+		}
+		Uint64 t_transform = SDL_GetPerformanceCounter();
+
 		SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0xFF);
 		SDL_RenderClear(renderer);
 
-		render_object(renderer, cube_object, view, perspective, w, h, 0, 1);
-		render_object(renderer, cube_object, view, perspective, w, h, 1, 1);
+		// textes seuls : la texture garde la derniere frame rasterisee
+		if (!redraw) {
+			SDL_RenderCopy(renderer, framebuffer->texture, NULL, NULL);
+		} else if (begin_frame(framebuffer, RASTER_RGB(0, 0, 0))) {
+			raster_object(framebuffer, cube_object, view_projection, NULL, 0, 1);
+			raster_object(framebuffer, cube_object, view_projection, NULL, 1, 1);
 
-		render_object(renderer, colors_object, view, perspective, w, h, 1, 1);
+			if (colors_lod)
+				raster_projected_point_cloud_sized(framebuffer, colors_cloud, colors_lod->radius[colors_level]);
+			else if (colors_stream)
+				raster_projected_point_cloud(framebuffer, colors_cloud, 1);
 
-		render_object(renderer, palette_object, view, perspective, w, h, 1, 5);
+			if (trajectory_points > 1)
+				raster_projected_polylines(framebuffer, palettes_cloud, palettes_k, trajectory_points);
+			raster_projected_point_cloud(framebuffer, palette_cloud, 5);
 
+			end_frame(framebuffer, renderer);
+		}
+		Uint64 t_render = SDL_GetPerformanceCounter();
 
 		stringRGBA(renderer, 10, 10, colors_inf, 255, 255, 255, 255);
 		stringRGBA(renderer, 10, 22, k_mean_palette_iteration, 255, 255, 255, 255);
+		stringRGBA(renderer, 10, 34, frame_inf, 255, 255, 0, 255);
 
-		SDL_RenderCopy(renderer, image_texture, NULL, 
-			&(SDL_Rect){w - small_image->width, h - small_image->height, small_image->width, small_image->height});
+		if (image_texture)
+			SDL_RenderCopy(renderer, image_texture, NULL, 
+				&(SDL_Rect){w - small_image->width, h - small_image->height, small_image->width, small_image->height});
 
 		SDL_RenderPresent(renderer);
-		transform_object(cube_object, mat_y_rotation_cube);
-		transform_object(colors_object, mat_y_rotation_cube);
-		transform_object(palette_object, mat_y_rotation_cube);
-		current_angle += 0.2;
-		
-		SDL_Delay(5);
+		Uint64 t_present = SDL_GetPerformanceCounter();
+
+		double transform_ms = elapsed_ms(t_start, t_transform);
+		double render_ms = elapsed_ms(t_transform, t_render);
+		double present_ms = elapsed_ms(t_render, t_present);
+		double total_ms = elapsed_ms(t_start, t_present);
+		// en benchmark, seules les frames avec l'analyse terminee comptent
+		if (benchmark_frames > 0 && !analysis_done)
+			stats = (FRAME_STATS){ .min_total = 1e30 };
+		stats.frames++;
+		stats.transform += transform_ms;
+		stats.render += render_ms;
+		stats.present += present_ms;
+		stats.total += total_ms;
+		stats.min_total = total_ms < stats.min_total ? total_ms : stats.min_total;
+		stats.max_total = MAX(stats.max_total, total_ms);
+		stats.avg_total = stats.frames == 1 ? total_ms : 0.95 * stats.avg_total + 0.05 * total_ms;
+		sprintf(frame_inf, "%.0f fps  %.2f ms (transform %.2f / render %.2f / present %.2f)  %d points lod %d",
+			1000.0 / stats.avg_total, total_ms, transform_ms, render_ms, present_ms,
+			(colors_cloud ? colors_cloud->length : 0) + palette_cloud->length, colors_level);
+
+		dirty = 0;
+
+		if (benchmark_frames > 0) {
+			if (analysis_done && stats.frames >= benchmark_frames)
+				exit = 1;
+		} else if (!paused) {
+			SDL_Delay(5);
+		}
 	}
 
-	free_object(cube_object);
-	free_object(colors_object);
-	free_object(palette_object);
-	SDL_DestroyTexture(image_texture);
+	if (benchmark_frames > 0)
+		print_frame_stats(&stats);
+
+	free_scene();
+	free_framebuffer(framebuffer);
+	if (image_texture)
+		SDL_DestroyTexture(image_texture);
 	destroy_window();
 
 }
 
 
 
+//------------------------------------------------------------------------------
+// Nuage qui partage positions et couleurs avec pc mais projete dans ses
+// propres tableaux, pour projeter le meme nuage dans plusieurs threads
+//------------------------------------------------------------------------------
+static void *share_point_cloud(point_cloud *copy, point_cloud *pc)
+{
+	*copy = *pc;
+	int n = pc->length > 0 ? pc->length : 1;
+	void *buffer = malloc(n * (sizeof(float) + 2 * sizeof(int) + 1));
+	if (!buffer)
+		return NULL;
+	copy->depth = buffer;
+	copy->sx = (int *)(copy->depth + n);
+	copy->sy = copy->sx + n;
+	copy->visible = (unsigned char *)(copy->sy + n);
+	copy->buffer = NULL;
+	return buffer;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Objet qui partage sommets et faces avec o mais projete dans son propre bloc
+//------------------------------------------------------------------------------
+static void *share_object(object *copy, object *o)
+{
+	*copy = *o;
+	int n = o->vertices_capacity > 0 ? o->vertices_capacity : 1;
+	copy->projection = malloc(n * PROJECTED_VERTEX_SIZE);
+	copy->buffer = NULL;
+	return copy->projection;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Rendu sans fenetre de frames images d'un tour complet du cube, une fois
+// l'analyse terminee. Les angles sont independants : chaque lot de frames
+// est rendu en parallele, un framebuffer headless et des projections par
+// frame. Sortie en GIF si output finit par .gif (palette de la methode de
+// Wu sur la premiere frame), sinon output_0000.ppm, output_0001.ppm...
+//------------------------------------------------------------------------------
+#define OFFSCREEN_BATCH	16
+#define GIF_DELAY	4	// centiemes de seconde, 25 images/s
+
+static int render_offscreen(char *output, int frames)
+{
+	while (!analysis_done) {
+		if (!handle_analysis())
+			return 0;
+		SDL_Delay(10);
+	}
+
+	orbit_camera view;
+	default_camera(&view);
+
+	// la rotation passe dans la camera, les modeles restent fixes
+	colors_level = select_color_lod(colors_lod, view.distance, point_budget);
+	colors_cloud = colors_lod->clouds[colors_level];
+	mat4_identity(cube_object->model);
+	mat4_identity(colors_cloud->model);
+	mat4_identity(palette_cloud->model);
+
+	size_t length = strlen(output);
+	int gif_output = length >= 4 && strcmp(output + length - 4, ".gif") == 0;
+	GIF_WRITER *gif = NULL;
+	unsigned char *lookup = NULL;
+
+	FRAMEBUFFER *fbs[OFFSCREEN_BATCH] = {NULL};
+	point_cloud colors_copies[OFFSCREEN_BATCH], palette_copies[OFFSCREEN_BATCH];
+	object cube_copies[OFFSCREEN_BATCH];
+	void *buffers[3 * OFFSCREEN_BATCH] = {NULL};
+	unsigned char *indexes[OFFSCREEN_BATCH] = {NULL};
+	int ok = 1;
+	for (int i = 0; i < OFFSCREEN_BATCH && ok; i++) {
+		fbs[i] = create_framebuffer(NULL, w, h);
+		buffers[3 * i] = share_point_cloud(&colors_copies[i], colors_cloud);
+		buffers[3 * i + 1] = share_point_cloud(&palette_copies[i], palette_cloud);
+		buffers[3 * i + 2] = share_object(&cube_copies[i], cube_object);
+		indexes[i] = gif_output ? malloc(w * h) : NULL;
+		ok = fbs[i] && buffers[3 * i] && buffers[3 * i + 1] && buffers[3 * i + 2] && (!gif_output || indexes[i]);
+	}
+
+	for (int first = 0; ok && first < frames; first += OFFSCREEN_BATCH) {
+		int count = MIN(OFFSCREEN_BATCH, frames - first);
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < count; i++) {
+			FRAMEBUFFER *fb = fbs[i];
+			mfloat_t rotation[MAT4_SIZE];
+			mfloat_t camera[MAT4_SIZE];
+			mat4_rotation_y(mat4_identity(rotation), to_radians(360.0 * (first + i) / frames));
+			mat4_multiply(camera, view.view_projection, rotation);
+
+			begin_frame(fb, RASTER_RGB(0, 0, 0));
+			raster_object(fb, &cube_copies[i], camera, NULL, 0, 1);
+			raster_object(fb, &cube_copies[i], camera, NULL, 1, 1);
+			project_point_cloud(&colors_copies[i], camera, NULL, w, h);
+			raster_projected_point_cloud_sized(fb, &colors_copies[i], colors_lod->radius[colors_level]);
+			project_point_cloud(&palette_copies[i], camera, NULL, w, h);
+			raster_projected_point_cloud(fb, &palette_copies[i], 5);
+			end_frame(fb, NULL);
+		}
+
+		if (gif_output && !gif) {
+			PALETTE palette;
+			unsigned int *keys = malloc(w * h * sizeof(unsigned int));
+			for (int i = 0; keys && i < w * h; i++)
+				keys[i] = fbs[0]->pixels[i] & 0xFFFFFF;
+			COLORS_HISTOGRAM *histogram = keys ? create_colors_histogram_from_keys(keys, w * h) : NULL;
+			free(keys);
+			if (histogram && quantize_histogram(histogram, &palette, K_MAX, QUANTIZE_WU) > 0) {
+				lookup = create_palette_lookup(&palette);
+				gif = lookup ? open_gif(output, w, h, &palette, GIF_DELAY) : NULL;
+			}
+			free_colors_histogram(histogram);
+			if (!gif) {
+				ok = 0;
+				break;
+			}
+		}
+
+		if (gif) {
+			#pragma omp parallel for schedule(static)
+			for (int i = 0; i < count; i++)
+				argb_to_indexes(fbs[i]->pixels, w, h, fbs[i]->pitch, lookup, indexes[i]);
+			for (int i = 0; i < count && ok; i++)
+				ok = write_gif_frame(gif, indexes[i]);
+		} else {
+			char filename[1024];
+			for (int i = 0; i < count && ok; i++) {
+				snprintf(filename, sizeof(filename), "%s_%04d.ppm", output, first + i);
+				ok = write_ppm(filename, fbs[i]->pixels, w, h, fbs[i]->pitch);
+			}
+		}
+		printf("frames %d/%d\n", first + count, frames);
+		fflush(stdout);
+	}
+
+	close_gif(gif);
+	free(lookup);
+	for (int i = 0; i < OFFSCREEN_BATCH; i++) {
+		free_framebuffer(fbs[i]);
+		free(buffers[3 * i]);
+		free(buffers[3 * i + 1]);
+		free(buffers[3 * i + 2]);
+		free(indexes[i]);
+	}
+	return ok;
+}
+
+
+
 int main(int argc, char *argv[])
 {
 	the_log();
 
-	int threshold = 20;
-	int count_24;
-	int count = 0;
-	int r, g, b;
-	double x_coord, y_coord, z_coord;
-	color c;
-	unsigned int *first_key, *last_key, *current_key;
 	k_palettes = malloc(max_iter * sizeof(PALETTE));
 
 
-	if (argc < 2) {
+	// options : -b <frames> pour le mode benchmark, -o <sortie> [-n <frames>]
+	// pour le rendu sans fenetre, le reste est positionnel
+	char *args[2] = {NULL, NULL};
+	char *output = NULL;
+	int output_frames = 120;
+	int nargs = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			benchmark_frames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			output_frames = atoi(argv[++i]);
+		} else if (nargs < 2) {
+			args[nargs++] = argv[i];
+		}
+	}
+
+	if (nargs < 1) {
 		printf("Image jpg en argument");
 		return 0;
 	}
 
-	if (argc >= 3) {
-		threshold = atoi(argv[2]);
+	if (nargs >= 2) {
+		threshold = atoi(args[1]);
 		if (threshold == 0) {
 			printf("Seuil par défaut à 20\n");
 			threshold = 20;
@@ -287,7 +798,7 @@ int main(int argc, char *argv[])
 		printf("Seuil par défaut à 20\n");
 	}
 
-	if (!create_window()) {
+	if (!output && !create_window()) {
 		printf("Impossible de creer l'ecran\n");
 		return 0;
 	}
@@ -295,79 +806,29 @@ int main(int argc, char *argv[])
 	init();
 
 
-	the_image = load(argv[1]);
-	if (!the_image)
-		return 0;
-
+	// place pour toutes les iterations des le depart : les vues restent valides
+	palettes_k = k;
+	palettes_cloud = create_point_cloud(max_iter * k);
+	live_cloud = create_point_cloud(K_MAX);
+	palette_cloud = live_cloud;
+	if (!output)
+		colors_stream = create_color_stream(threshold);
 
-	float ratio = 1.0;
-	float ratio_x, ratio_y;
-	if (the_image->width >= 160) {
-		ratio_x = the_image->width / 160.0;
-		printf("ratio x %f\n", ratio_x);
-	}
-	if (the_image->height > 100) {
-		ratio_y = the_image->height / 100.0;
-		printf("ratio y %f\n", ratio_y);
+	// chargement, nuage et kmean arrivent pendant l'affichage
+	analysis = start_analysis(args[0], threshold, k, max_iter, k_palettes, 160, 100);
+	if (!analysis) {
+		printf("Impossible de lancer l'analyse\n");
+		return 0;
 	}
-	ratio = MAX(ratio_x, ratio_y);
-	small_image = bilinear_resize(the_image,
-						    (int)the_image->width / ratio,
-						    (int)the_image->height / ratio);
-	image_texture = create_texture_from_image(small_image->pixels, small_image->width, small_image->height);
-
-
-	colors_object = create_object(0);
-	palette_object = create_object(0);
-
-	map the_colors;
-	get_colors_map(the_image, &the_colors);
-	size_t colors_count = map_size(the_colors);
-	printf("Nombre de couleurs: %d\n", colors_count);
-
-	iter_result = guess_palette_kmean(the_image, k_palettes, k, max_iter);
-	current_palette_display = iter_result - 1;
-	sprintf(k_mean_palette_iteration, "k-mean iteration: %d/%d  (+/-)", current_palette_display + 1, iter_result);
-	update_palette(current_palette_display);
-
-	first_key = map_first(the_colors);
-	last_key = map_last(the_colors);
-
-	current_key = first_key;
-	while (current_key != NULL) {
-		map_get(&count_24, the_colors, current_key);
-		// printf("get %u -> %u:%d\n", color_index, *current_key, count_24);
-
-		r = (*current_key) / 65536;
-		g = ((*current_key) % 65536) / 256;
-		b = ((*current_key) % 65536) % 256;
-
-		if (count_24 >= threshold) {
-			x_coord = r / 128.0 - 1.0;
-			y_coord = g / 128.0 - 1.0;
-			z_coord = b / 128.0 - 1.0;
-			c.r = r;
-			c.g = g;
-			c.b = b;
-
-			vertex *v = create_vertex_color(x_coord, y_coord, z_coord, c);
-			face *f = create_face(1, v);
-			add_face_to_object(colors_object, f);
-
-			count++;
-		}
-
-		current_key = map_higher(the_colors, current_key);
+	if (output) {
+		if (!render_offscreen(output, output_frames > 0 ? output_frames : 1))
+			printf("Rendu de %s impossible\n", output);
+		free_scene();
+	} else {
+		sprintf(colors_inf, "analyse de %s...", args[0]);
+		message_loop();
 	}
-	printf("couleurs affichees: %d\n", count);
-
-	fflush(stdout);
-
-	sprintf(colors_inf, "%d couleurs affichees sur %d au total", count, colors_count);
-	message_loop();
 
-	map_destroy(the_colors);
-	free_image(the_image);
 	free_image(small_image);
 	free(k_palettes);
 
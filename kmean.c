@@ -2,6 +2,7 @@
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #define max(a, b)    (((a) > (b)) ? (a) : (b))
@@ -21,170 +22,141 @@ int rand_int(int n)
 }
 
 
-int nearest_color(COLOR c, vector *color_vector)
+int guess_palette_kmean(IMAGE *image, PALETTE *palette, int k, int max_iter)
 {
-    float dist_min = FLT_MAX;
-    float dist = 0;
-    int idx;
-    COLOR current_color;
-    unsigned char c1[3], c2[3];
-    for (int i = 0; i < vector_size(*color_vector); i++) {
-        vector_get_at(&current_color, *color_vector, i);
-        c1[0] = c.r;
-        c1[1] = c.g;
-        c1[2] = c.b;
-        c2[0] = current_color.r;
-        c2[1] = current_color.g;
-        c2[2] = current_color.b;
-        dist = color_delta_f(c1, c2);
-        if (dist < dist_min) {
-            dist_min = dist;
-            idx = i;
-        }
-    }
-    return idx;
+    return guess_palette_kmean_space(image, palette, k, max_iter, COLOR_SPACE_RGB);
 }
 
 
-void colors_mean(vector *color_vector, COLOR *mean)
+
+int guess_palette_kmean_space(IMAGE *image, PALETTE *palette, int k, int max_iter, int space)
 {
-   int sz = vector_size(*color_vector);
-   COLOR current_color;
-   unsigned int r = 0, g = 0, b = 0;
-
-   for (int i = 0; i < sz; i++) {
-        vector_get_at(&current_color, *color_vector, i);
-        r += current_color.r;
-        g += current_color.g;
-        b += current_color.b;
+    COLOR_PLANES *planes = create_color_planes(image, space);
+    if (planes == NULL) {
+        return 0;
     }
 
-    mean->r = r / sz;
-    mean->g = g / sz;
-    mean->b = b / sz;
+    int iter_count = guess_palette_kmean_planes(planes, palette, k, max_iter);
+
+    free_color_planes(planes);
+    return iter_count;
 }
 
 
-float color_variance(vector *color_vector)
+
+int guess_palette_kmean_planar(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space)
 {
-    int sz = vector_size(*color_vector);
-
-    COLOR mean;
-    COLOR current_color;
-    unsigned char c1[3], c2[3];
-    colors_mean(color_vector, &mean);
-    float dist = 0, dist_sum = 0;
-    for (int i = 0; i < sz; i++) {
-        vector_get_at(&current_color, *color_vector, i);
-        c1[0] = mean.r;
-        c1[1] = mean.g;
-        c1[2] = mean.b;
-        c2[0] = current_color.r;
-        c2[1] = current_color.g;
-        c2[2] = current_color.b;
-        dist = color_delta_f(c1, c2);
-        dist_sum += (dist*dist);
-    }
-    return dist_sum / (float) sz;
+    return guess_palette_kmean_planar_seeded(image, palette, k, max_iter, space, NULL);
 }
 
 
-void new_cluster_list(int k, vector *cluster_vector)
+
+int guess_palette_kmean_planar_seeded(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space, PALETTE *seeds)
 {
-    for (int i = 0; i < k; i++) {
-        CLUSTER_LIST cl;
-        cl.cluster_vector = vector_init(sizeof(COLOR));
-        vector_add_last(*cluster_vector, &cl);
-    }
+    return guess_palette_kmean_planar_callback(image, palette, k, max_iter, space, seeds, NULL, NULL);
 }
 
-void free_cluster_list(vector *cluster_vector)
+
+
+int guess_palette_kmean_planar_callback(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space, PALETTE *seeds,
+    KMEAN_CALLBACK callback, void *data)
 {
-    CLUSTER_LIST current_cluster_list;
-    for (int i = 0; i < vector_size(*cluster_vector); i++) {
-        vector_get_at(&current_cluster_list, *cluster_vector, i);
-        vector_destroy(current_cluster_list.cluster_vector);
+    COLOR_PLANES *planes = create_color_planes_planar(image, space);
+    if (planes == NULL) {
+        return 0;
     }
+
+    int iter_count = guess_palette_kmean_planes_callback(planes, palette, k, max_iter, seeds, callback, data);
+
+    free_color_planes(planes);
+    return iter_count;
 }
 
 
 
-void get_cluster_centroid(IMAGE *image, vector *cluster_vector, vector *centroid_vector)
+int guess_palette_kmean_planes(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter)
 {
-    CLUSTER_LIST current_cluster;
+    return guess_palette_kmean_planes_seeded(planes, palette, k, max_iter, NULL);
+}
 
-    int cl_size = vector_size(*cluster_vector);
 
-    
 
-    vector_clear(*centroid_vector);
-    for (int i = 0; i < cl_size; i++) {
-        COLOR no_color = {-1, -1, -1};
-        vector_add_last(*centroid_vector, &no_color);
-    }
-    
-
-    for (int i = 0; i < cl_size; i++) {        
-        vector_get_at(&current_cluster, *cluster_vector, i);
-        if (vector_size(current_cluster.cluster_vector) > 0) {
-            COLOR c_mean;
-            colors_mean(&current_cluster.cluster_vector, &c_mean);
-            vector_set_at(*centroid_vector, i, &c_mean);
-        } else {
-            int r = rand_int(image->height * image->width);
-            PIXEL p = image->pixels[r];
-            COLOR c;
-            c.r = p.r;
-            c.g = p.g;
-            c.b = p.b;
-            vector_set_at(*centroid_vector, i, &c);
-        }
-    }
+int guess_palette_kmean_planes_seeded(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter, PALETTE *seeds)
+{
+    return guess_palette_kmean_planes_callback(planes, palette, k, max_iter, seeds, NULL, NULL);
 }
 
 
 
-
-int guess_palette_kmean(IMAGE *image, PALETTE *palette, int k, int max_iter)
+int guess_palette_kmean_planes_callback(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter, PALETTE *seeds,
+    KMEAN_CALLBACK callback, void *data)
 {
-    vector clusters_vector = vector_init(sizeof(CLUSTER_LIST));
-    vector centroid_vector = vector_init(sizeof(COLOR));
-    unsigned long image_size =  image->height * image->width;
-    printf("kmean taille image:%d\n", image_size);
+    int size = planes->size;
+    printf("kmean taille image:%d\n", size);
     fflush(stdout);
 
-    new_cluster_list(k, &clusters_vector);
-
-    int iter = 0/*, max_iter = 100*/;
+    float (*centroids)[3] = malloc(sizeof(float) * 3 * k);
+    double (*sums)[3] = malloc(sizeof(double) * 3 * k);
+    double *squares = malloc(sizeof(double) * k);
+    unsigned long *counts = malloc(sizeof(unsigned long) * k);
     float *previous_variance = (float *) malloc(sizeof(float) * k);
-    for (int i = 0; i < k; i++) previous_variance[i] = 1.0;
+
+    int iter = 0;
     float variance = 0.0, delta = 0.0, delta_max = 0.0, threshold = 0.00005;
-    CLUSTER_LIST current_cluster;
-    COLOR current_color;
+
+    for (int i = 0; i < k; i++) {
+        previous_variance[i] = 1.0;
+        counts[i] = 0;
+    }
+
+    // Les graines remplacent le tirage au hasard de la premiere iteration
+    int seeded = seeds ? seeds->size : 0;
+    seeded = seeded > k ? k : seeded;
+    for (int i = 0; i < seeded; i++) {
+        rgb_to_color_space(planes->space, seeds->colors[i][0], seeds->colors[i][1], seeds->colors[i][2], centroids[i]);
+    }
 
     while(1) {
-        // Génération des clusters
-        get_cluster_centroid(image, &clusters_vector, &centroid_vector);
-        free_cluster_list(&clusters_vector);
-        vector_clear(clusters_vector);
-        new_cluster_list(k, &clusters_vector);
-
-        for (int i = 0; i < image->height * image->width; i++) {
-            PIXEL p = image->pixels[i];
-            COLOR c;
-            c.r = p.r;
-            c.g = p.g;
-            c.b = p.b;
-            int nc_idx = nearest_color(c, &centroid_vector);
-            vector_get_at(&current_cluster, clusters_vector, nc_idx);
-            vector_add_last(current_cluster.cluster_vector, &c);
+        // Centroides : moyenne des clusters ou pixel au hasard si vide
+        for (int i = 0; i < k; i++) {
+            if (iter == 0 && i < seeded) {
+                // centroide deja initialise
+            } else if (counts[i] > 0) {
+                centroids[i][0] = sums[i][0] / counts[i];
+                centroids[i][1] = sums[i][1] / counts[i];
+                centroids[i][2] = sums[i][2] / counts[i];
+            } else {
+                int r = rand_int(size - 1);
+                centroids[i][0] = planes->c0[r];
+                centroids[i][1] = planes->c1[r];
+                centroids[i][2] = planes->c2[r];
+            }
+            sums[i][0] = sums[i][1] = sums[i][2] = 0;
+            squares[i] = 0;
+            counts[i] = 0;
+        }
+
+        // Generation des clusters
+        for (int i = 0; i < size; i++) {
+            float c[3] = { planes->c0[i], planes->c1[i], planes->c2[i] };
+            int nc_idx = find_closest_color_index_space(c, centroids, k);
+            sums[nc_idx][0] += c[0];
+            sums[nc_idx][1] += c[1];
+            sums[nc_idx][2] += c[2];
+            squares[nc_idx] += c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+            counts[nc_idx]++;
         }
 
         // Test de la convergence
         delta_max = 0;
-        for (int i = 0; i < vector_size(clusters_vector); i++) {
-            vector_get_at(&current_cluster, clusters_vector, i);
-            variance = color_variance(&(current_cluster.cluster_vector));
+        for (int i = 0; i < k; i++) {
+            variance = 0;
+            if (counts[i] > 0) {
+                double m0 = sums[i][0] / counts[i];
+                double m1 = sums[i][1] / counts[i];
+                double m2 = sums[i][2] / counts[i];
+                variance = squares[i] / counts[i] - (m0 * m0 + m1 * m1 + m2 * m2);
+            }
             delta = fabs(previous_variance[i] - variance);
             delta_max = max(delta, delta_max);
             previous_variance[i] = variance;
@@ -193,30 +165,165 @@ int guess_palette_kmean(IMAGE *image, PALETTE *palette, int k, int max_iter)
         printf("K-mean iteration %d - variance %f\n", iter, delta_max);
 
         // Sauvagarde des palettes
-        for (int i = 0; i < vector_size(centroid_vector); i++) {
-            vector_get_at(&current_color, centroid_vector, i);
-            printf("Color %d %d %d %d\n", i, current_color.r, current_color.g, current_color.b);
-            fflush(stdout);
-            palette[iter].colors[i][0] = current_color.r;
-            palette[iter].colors[i][1] = current_color.g;
-            palette[iter].colors[i][2] = current_color.b;
-            palette[iter].size = vector_size(centroid_vector);
+        for (int i = 0; i < k; i++) {
+            color_space_to_rgb(planes->space, centroids[i], palette[iter].colors[i]);
+            printf("Color %d %d %d %d\n", i, palette[iter].colors[i][0], palette[iter].colors[i][1], palette[iter].colors[i][2]);
         }
+        palette[iter].size = k;
 
         fflush(stdout);
-        if (delta_max < threshold || iter++ > max_iter) {
+        if (callback != NULL && callback(iter, &palette[iter], data)) {
+            break;
+        }
+        if (delta_max < threshold || iter + 1 >= max_iter) {
             break;
         }
+        iter++;
     }
 
-
-    
+    free(centroids);
+    free(sums);
+    free(squares);
+    free(counts);
     free(previous_variance);
 
-    free_cluster_list(&clusters_vector);
+    return iter + 1;
+}
 
-    vector_destroy(clusters_vector);
-    vector_destroy(centroid_vector);
 
-    return iter + 1;
+
+
+#define KMEAN_HISTOGRAM_MOVE    0.25    // deplacement max (RGB pondere) pour la convergence
+
+int kmean_histogram(COLORS_HISTOGRAM *histogram, float (*centroids)[3], unsigned long long *counts, int k, int max_iter)
+{
+    int size = histogram->size;
+    double (*sums)[3] = malloc(sizeof(double) * 3 * k);
+    if (sums == NULL) {
+        return 0;
+    }
+
+    int iter = 0;
+    while (iter < max_iter) {
+        memset(sums, 0, sizeof(double) * 3 * k);
+        memset(counts, 0, sizeof(unsigned long long) * k);
+
+        // Affectation des couleurs, sommes locales a chaque thread
+        #pragma omp parallel
+        {
+            double local_sums[32][3] = {{0}};
+            unsigned long long local_counts[32] = {0};
+
+            #pragma omp for schedule(static)
+            for (int i = 0; i < size; i++) {
+                unsigned int key = histogram->colors[i];
+                float c[3];
+                rgb_to_color_space(COLOR_SPACE_RGB, (key >> 16) & 0xFF, (key >> 8) & 0xFF, key & 0xFF, c);
+                unsigned int n = histogram->counts[i];
+                int nc_idx = find_closest_color_index_space(c, centroids, k);
+                local_sums[nc_idx][0] += (double)c[0] * n;
+                local_sums[nc_idx][1] += (double)c[1] * n;
+                local_sums[nc_idx][2] += (double)c[2] * n;
+                local_counts[nc_idx] += n;
+            }
+
+            #pragma omp critical
+            for (int i = 0; i < k; i++) {
+                sums[i][0] += local_sums[i][0];
+                sums[i][1] += local_sums[i][1];
+                sums[i][2] += local_sums[i][2];
+                counts[i] += local_counts[i];
+            }
+        }
+        iter++;
+
+        // Nouveaux centroides, un cluster vide garde le sien
+        float move = 0;
+        for (int i = 0; i < k; i++) {
+            if (counts[i] == 0) {
+                continue;
+            }
+            for (int j = 0; j < 3; j++) {
+                float m = sums[i][j] / counts[i];
+                move = max(move, fabsf(m - centroids[i][j]));
+                centroids[i][j] = m;
+            }
+        }
+        if (move < KMEAN_HISTOGRAM_MOVE) {
+            break;
+        }
+    }
+
+    free(sums);
+    return iter;
+}
+
+
+
+void kmean_split_largest(COLORS_HISTOGRAM *histogram, float (*centroids)[3], unsigned long long *counts, int k)
+{
+    int largest = 0;
+    for (int i = 1; i < k; i++) {
+        if (counts[i] > counts[largest]) {
+            largest = i;
+        }
+    }
+
+    // Ecart type de chaque composante dans le cluster
+    double squares[3] = {0}, total = 0;
+    for (unsigned int i = 0; i < histogram->size; i++) {
+        unsigned int key = histogram->colors[i];
+        float c[3];
+        rgb_to_color_space(COLOR_SPACE_RGB, (key >> 16) & 0xFF, (key >> 8) & 0xFF, key & 0xFF, c);
+        if (find_closest_color_index_space(c, centroids, k) != largest) {
+            continue;
+        }
+        for (int j = 0; j < 3; j++) {
+            double d = c[j] - centroids[largest][j];
+            squares[j] += d * d * histogram->counts[i];
+        }
+        total += histogram->counts[i];
+    }
+    int axis = 0;
+    for (int j = 1; j < 3; j++) {
+        if (squares[j] > squares[axis]) {
+            axis = j;
+        }
+    }
+    float offset = total > 0 ? sqrt(squares[axis] / total) : 1.0;
+    offset = offset < 1.0 ? 1.0 : offset;
+
+    memcpy(centroids[k], centroids[largest], sizeof(centroids[k]));
+    centroids[largest][axis] -= offset;
+    centroids[k][axis] += offset;
+    counts[k] = counts[largest] / 2;
+    counts[largest] -= counts[k];
+}
+
+
+
+void kmean_merge_closest(float (*centroids)[3], unsigned long long *counts, int k)
+{
+    int a = 0, b = 1;
+    float best = FLT_MAX;
+    for (int i = 0; i < k; i++) {
+        for (int j = i + 1; j < k; j++) {
+            float d = color_space_delta(centroids[i], centroids[j]);
+            if (d < best) {
+                best = d;
+                a = i;
+                b = j;
+            }
+        }
+    }
+
+    // Moyenne ponderee, le dernier centroide prend la place de b
+    unsigned long long n = counts[a] + counts[b];
+    for (int j = 0; j < 3; j++) {
+        centroids[a][j] = n > 0 ? (centroids[a][j] * (double)counts[a] + centroids[b][j] * (double)counts[b]) / n
+            : (centroids[a][j] + centroids[b][j]) / 2;
+    }
+    counts[a] = n;
+    memcpy(centroids[b], centroids[k - 1], sizeof(centroids[b]));
+    counts[b] = counts[k - 1];
 }
@@ -2,7 +2,7 @@
 #define KMEAN_H
 
 #include "pixel.h"
-#include <vector.h>
+#include "colorspace.h"
 
 struct COLOR_STRUCT {
     unsigned char r;
@@ -13,17 +13,64 @@ typedef struct COLOR_STRUCT COLOR;
 
 
 
-struct CLUSTER_LIST_STRUCT {
-    vector cluster_vector;
-};
-typedef struct CLUSTER_LIST_STRUCT CLUSTER_LIST;
-
-
-
 //------------------------------------------------------------------------------
 // Trouve une palette adaptee a l'image avec kmean
 //------------------------------------------------------------------------------
 // void guess_palette_kmean(IMAGE *image, PALETTE *palette, int reduc_size);
 int guess_palette_kmean(IMAGE *image, PALETTE *palette, int k, int max_iter);
 
+//------------------------------------------------------------------------------
+// Kmean dans un espace de couleur (COLOR_SPACE_RGB, COLOR_SPACE_LAB,
+// COLOR_SPACE_OKLAB). L'image est convertie une seule fois.
+// palette doit pouvoir contenir max_iter palettes, une par iteration.
+// Retourne le nombre d'iterations effectuees.
+//------------------------------------------------------------------------------
+int guess_palette_kmean_space(IMAGE *image, PALETTE *palette, int k, int max_iter, int space);
+
+//------------------------------------------------------------------------------
+// Kmean sur une image planaire
+//------------------------------------------------------------------------------
+int guess_palette_kmean_planar(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space);
+
+//------------------------------------------------------------------------------
+// Kmean sur une image deja convertie
+//------------------------------------------------------------------------------
+int guess_palette_kmean_planes(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter);
+
+//------------------------------------------------------------------------------
+// Kmean initialise avec les couleurs de seeds (par exemple le resultat d'un
+// quantificateur de quantize.h) au lieu de pixels au hasard
+//------------------------------------------------------------------------------
+int guess_palette_kmean_planes_seeded(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter, PALETTE *seeds);
+int guess_palette_kmean_planar_seeded(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space, PALETTE *seeds);
+
+//------------------------------------------------------------------------------
+// Fonction appelee apres chaque iteration avec la palette de l'iteration
+// Une valeur non nulle arrete le kmean apres cette iteration.
+//------------------------------------------------------------------------------
+typedef int (*KMEAN_CALLBACK)(int iter, PALETTE *palette, void *data);
+
+int guess_palette_kmean_planes_callback(COLOR_PLANES *planes, PALETTE *palette, int k, int max_iter, PALETTE *seeds,
+    KMEAN_CALLBACK callback, void *data);
+int guess_palette_kmean_planar_callback(PLANAR_IMAGE *image, PALETTE *palette, int k, int max_iter, int space, PALETTE *seeds,
+    KMEAN_CALLBACK callback, void *data);
+
+//------------------------------------------------------------------------------
+// Kmean pondere sur l'histogramme des couleurs : chaque couleur compte pour
+// son nombre de pixels. Les centroides sont dans l'espace COLOR_SPACE_RGB
+// (composantes ponderees, voir rgb_to_color_space), comme ceux du kmean sur
+// l'image. Demarre des k centroides fournis (pas de tirage), counts recoit le
+// nombre de pixels de chaque cluster.
+// Retourne le nombre d'iterations effectuees.
+//------------------------------------------------------------------------------
+int kmean_histogram(COLORS_HISTOGRAM *histogram, float (*centroids)[3], unsigned long long *counts, int k, int max_iter);
+
+//------------------------------------------------------------------------------
+// Passage de k a k + 1 centroides en coupant le plus gros cluster en deux le
+// long de son axe le plus etale, ou a k - 1 en fusionnant les deux plus
+// proches. Les tableaux doivent pouvoir contenir k + 1 elements.
+//------------------------------------------------------------------------------
+void kmean_split_largest(COLORS_HISTOGRAM *histogram, float (*centroids)[3], unsigned long long *counts, int k);
+void kmean_merge_closest(float (*centroids)[3], unsigned long long *counts, int k);
+
 #endif
\ No newline at end of file
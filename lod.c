@@ -0,0 +1,376 @@
+#include "lod.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define RED(c)		(((c) >> 16) & 0xFF)
+#define GREEN(c)	(((c) >> 8) & 0xFF)
+#define BLUE(c)		((c) & 0xFF)
+
+
+// Somme des pixels d'un voxel et de leurs composantes
+typedef struct VOXEL {
+	unsigned long long	count;
+	unsigned long long	r;
+	unsigned long long	g;
+	unsigned long long	b;
+} VOXEL;
+
+
+
+//------------------------------------------------------------------------------
+// Rayon d'un voxel : 1 pixel de plus par facteur 16 de pixels, borne par le
+// niveau pour que les grilles fines restent fines
+//------------------------------------------------------------------------------
+static unsigned char voxel_radius(unsigned long long count, int level)
+{
+	int radius = 0;
+	while (radius < level && (count >> (4 * (radius + 1))) != 0)
+		radius++;
+	return radius;
+}
+
+
+
+static int compare_descending(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+	return (x < y) - (x > y);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Voxels non vides par nombre de pixels decroissant, le compte dans les bits
+// de poids fort et l'indice du voxel dans les 24 autres
+//------------------------------------------------------------------------------
+static int emit_level(COLOR_LOD *lod, int level, VOXEL *grid, int side)
+{
+	int cells = side * side * side;
+	int n = 0;
+	for (int i = 0; i < cells; i++) {
+		if (grid[i].count)
+			n++;
+	}
+
+	unsigned long long *order = malloc((n > 0 ? n : 1) * sizeof(unsigned long long));
+	lod->clouds[level] = create_point_cloud(n);
+	lod->radius[level] = malloc(n > 0 ? n : 1);
+	lod->counts[level] = malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+	if (order == NULL || lod->clouds[level] == NULL || lod->radius[level] == NULL || lod->counts[level] == NULL) {
+		free(order);
+		return 0;
+	}
+
+	n = 0;
+	for (int i = 0; i < cells; i++) {
+		if (grid[i].count)
+			order[n++] = (grid[i].count << 24) | i;
+	}
+	qsort(order, n, sizeof(unsigned long long), compare_descending);
+
+	for (int i = 0; i < n; i++) {
+		VOXEL *v = &grid[order[i] & 0xFFFFFF];
+		double r = (double)v->r / v->count;
+		double g = (double)v->g / v->count;
+		double b = (double)v->b / v->count;
+		color c = { (unsigned char)(r + 0.5), (unsigned char)(g + 0.5), (unsigned char)(b + 0.5) };
+		lod->radius[level][i] = voxel_radius(v->count, level);
+		lod->counts[level][i] = v->count < 0xFFFFFFFFu ? v->count : 0xFFFFFFFFu;
+		add_point(lod->clouds[level], r / 128.0 - 1.0, g / 128.0 - 1.0, b / 128.0 - 1.0, c);
+	}
+	lod->sizes[level] = n;
+	free(order);
+	return 1;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Grille de cote side / 2 : chaque voxel cumule ses 8 voxels fils
+//------------------------------------------------------------------------------
+static VOXEL *reduce_grid(VOXEL *grid, int side)
+{
+	int half = side / 2;
+	VOXEL *coarse = calloc((size_t)half * half * half, sizeof(VOXEL));
+	if (coarse == NULL)
+		return NULL;
+
+	for (int r = 0; r < side; r++) {
+		for (int g = 0; g < side; g++) {
+			for (int b = 0; b < side; b++) {
+				VOXEL *v = &grid[(r * side + g) * side + b];
+				VOXEL *p = &coarse[((r / 2) * half + g / 2) * half + b / 2];
+				p->count += v->count;
+				p->r += v->r;
+				p->g += v->g;
+				p->b += v->b;
+			}
+		}
+	}
+	return coarse;
+}
+
+
+
+COLOR_LOD *create_color_lod(COLORS_HISTOGRAM *histogram, int threshold)
+{
+	COLOR_LOD *lod = calloc(1, sizeof(COLOR_LOD));
+	if (lod == NULL)
+		return NULL;
+	mat4_identity(lod->model);
+
+	// niveau 0 : toutes les couleurs par nombre de pixels decroissant, le
+	// compte dans les bits de poids fort et la couleur dans les 24 autres
+	int n = histogram->size;
+	unsigned long long *order = malloc((n > 0 ? n : 1) * sizeof(unsigned long long));
+	lod->clouds[0] = create_point_cloud(n);
+	lod->radius[0] = calloc(n > 0 ? n : 1, 1);
+	lod->counts[0] = malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+	if (order == NULL || lod->clouds[0] == NULL || lod->radius[0] == NULL || lod->counts[0] == NULL) {
+		free(order);
+		free_color_lod(lod);
+		return NULL;
+	}
+	for (int i = 0; i < n; i++)
+		order[i] = ((unsigned long long)histogram->counts[i] << 24) | histogram->colors[i];
+	qsort(order, n, sizeof(unsigned long long), compare_descending);
+	for (int i = 0; i < n; i++) {
+		unsigned int key = order[i] & 0xFFFFFF;
+		color c = { RED(key), GREEN(key), BLUE(key) };
+		lod->counts[0][i] = order[i] >> 24;
+		add_point(lod->clouds[0], c.r / 128.0 - 1.0, c.g / 128.0 - 1.0, c.b / 128.0 - 1.0, c);
+	}
+	free(order);
+	lod->colors = n;
+	lod->sizes[0] = n;
+
+	// niveau 1 : toutes les couleurs dans la grille la plus fine
+	int side = 1 << LOD_GRID_BITS;
+	int shift = 8 - LOD_GRID_BITS;
+	VOXEL *grid = calloc((size_t)side * side * side, sizeof(VOXEL));
+	if (grid == NULL) {
+		free_color_lod(lod);
+		return NULL;
+	}
+	for (unsigned int i = 0; i < histogram->size; i++) {
+		unsigned int key = histogram->colors[i];
+		unsigned int count = histogram->counts[i];
+		VOXEL *v = &grid[(((RED(key) >> shift) * side) + (GREEN(key) >> shift)) * side + (BLUE(key) >> shift)];
+		v->count += count;
+		v->r += (unsigned long long)RED(key) * count;
+		v->g += (unsigned long long)GREEN(key) * count;
+		v->b += (unsigned long long)BLUE(key) * count;
+	}
+
+	for (int level = 1; level < LOD_LEVELS; level++) {
+		if (level > 1) {
+			VOXEL *coarse = reduce_grid(grid, side);
+			free(grid);
+			grid = coarse;
+			side /= 2;
+		}
+		if (grid == NULL || !emit_level(lod, level, grid, side)) {
+			free(grid);
+			free_color_lod(lod);
+			return NULL;
+		}
+	}
+	free(grid);
+	set_color_lod_threshold(lod, threshold);
+
+	return lod;
+}
+
+
+
+void free_color_lod(COLOR_LOD *lod)
+{
+	if (lod == NULL)
+		return;
+	for (int i = 0; i < LOD_LEVELS; i++) {
+		free_point_cloud(lod->clouds[i]);
+		free(lod->radius[i]);
+		free(lod->counts[i]);
+	}
+	free(lod);
+}
+
+
+
+int set_color_lod_threshold(COLOR_LOD *lod, int threshold)
+{
+	for (int level = 0; level < LOD_LEVELS; level++) {
+		// premier indice dont le compte est sous le seuil
+		unsigned int *counts = lod->counts[level];
+		int lo = 0, hi = lod->sizes[level];
+		while (lo < hi) {
+			int mid = lo + (hi - lo) / 2;
+			if (counts[mid] >= (unsigned int)threshold)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		lod->clouds[level]->length = lo;
+	}
+	return lod->clouds[0]->length;
+}
+
+
+
+int select_color_lod(COLOR_LOD *lod, mfloat_t distance, int budget)
+{
+	int coarse = 0;
+	for (mfloat_t d = distance; d >= 2 * LOD_REFERENCE_DISTANCE; d /= 2)
+		coarse++;
+
+	int level = 0;
+	while (level < LOD_LEVELS - 1 && (level < coarse || lod->clouds[level]->length > budget))
+		level++;
+
+	memcpy(lod->clouds[level]->model, lod->model, sizeof(lod->model));
+	return level;
+}
+
+
+
+COLOR_STREAM *create_color_stream(int threshold)
+{
+	COLOR_STREAM *stream = calloc(1, sizeof(COLOR_STREAM));
+	if (stream == NULL)
+		return NULL;
+
+	stream->threshold = threshold;
+	stream->capacity = 1 << 16;
+	stream->keys = calloc(stream->capacity, sizeof(unsigned int));
+	stream->counts = malloc(stream->capacity * sizeof(unsigned int));
+	stream->cloud = create_point_cloud(4096);
+	if (!stream->keys || !stream->counts || !stream->cloud) {
+		free_color_stream(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+
+
+void free_color_stream(COLOR_STREAM *stream)
+{
+	if (stream == NULL)
+		return;
+	for (int i = 0; i < stream->pending_count; i++)
+		free_colors_histogram(stream->pending[i]);
+	free(stream->pending);
+	free(stream->keys);
+	free(stream->counts);
+	free_point_cloud(stream->cloud);
+	free(stream);
+}
+
+
+
+int add_color_stream_band(COLOR_STREAM *stream, COLORS_HISTOGRAM *band)
+{
+	if (stream->pending_count == stream->pending_capacity) {
+		int capacity = stream->pending_capacity ? 2 * stream->pending_capacity : 16;
+		COLORS_HISTOGRAM **pending = realloc(stream->pending, capacity * sizeof(COLORS_HISTOGRAM *));
+		if (pending == NULL)
+			return 0;
+		stream->pending = pending;
+		stream->pending_capacity = capacity;
+	}
+	stream->pending[stream->pending_count++] = band;
+	return 1;
+}
+
+
+
+static inline unsigned int color_slot(unsigned int key, int capacity)
+{
+	return (key * 2654435761u) & (capacity - 1);
+}
+
+
+
+static int grow_color_table(COLOR_STREAM *stream)
+{
+	int capacity = 2 * stream->capacity;
+	unsigned int *keys = calloc(capacity, sizeof(unsigned int));
+	unsigned int *counts = malloc(capacity * sizeof(unsigned int));
+	if (!keys || !counts) {
+		free(keys);
+		free(counts);
+		return 0;
+	}
+	for (int i = 0; i < stream->capacity; i++) {
+		if (stream->keys[i] == 0)
+			continue;
+		unsigned int h = color_slot(stream->keys[i], capacity);
+		while (keys[h] != 0)
+			h = (h + 1) & (capacity - 1);
+		keys[h] = stream->keys[i];
+		counts[h] = stream->counts[i];
+	}
+	free(stream->keys);
+	free(stream->counts);
+	stream->keys = keys;
+	stream->counts = counts;
+	stream->capacity = capacity;
+	return 1;
+}
+
+
+
+static int merge_color(COLOR_STREAM *stream, unsigned int rgb, unsigned int count)
+{
+	if (2 * (stream->colors + 1) > stream->capacity && !grow_color_table(stream))
+		return 0;
+
+	unsigned int key = rgb + 1;
+	unsigned int h = color_slot(key, stream->capacity);
+	while (stream->keys[h] != 0 && stream->keys[h] != key)
+		h = (h + 1) & (stream->capacity - 1);
+
+	unsigned int previous = 0;
+	if (stream->keys[h] == 0) {
+		stream->keys[h] = key;
+		stream->counts[h] = count;
+		stream->colors++;
+	} else {
+		previous = stream->counts[h];
+		stream->counts[h] += count;
+	}
+
+	// la couleur franchit le seuil : elle entre dans le nuage
+	if (previous < (unsigned int)stream->threshold && stream->counts[h] >= (unsigned int)stream->threshold) {
+		color c = { RED(rgb), GREEN(rgb), BLUE(rgb) };
+		add_point(stream->cloud, c.r / 128.0 - 1.0, c.g / 128.0 - 1.0, c.b / 128.0 - 1.0, c);
+	}
+	return 1;
+}
+
+
+
+int merge_color_stream(COLOR_STREAM *stream, int max_entries)
+{
+	int merged = 0;
+
+	while (merged < max_entries && stream->pending_count > 0) {
+		COLORS_HISTOGRAM *band = stream->pending[0];
+		while (merged < max_entries && stream->position < band->size) {
+			if (!merge_color(stream, band->colors[stream->position], band->counts[stream->position]))
+				return merged;
+			stream->position++;
+			merged++;
+		}
+		if (stream->position == band->size) {
+			free_colors_histogram(band);
+			memmove(stream->pending, stream->pending + 1, (stream->pending_count - 1) * sizeof(COLORS_HISTOGRAM *));
+			stream->pending_count--;
+			stream->position = 0;
+		}
+	}
+	return merged;
+}
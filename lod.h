@@ -0,0 +1,85 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include "pixel.h"
+#include "3d.h"
+
+
+//------------------------------------------------------------------------------
+// Niveaux de detail du nuage des couleurs
+// Niveau 0 : une couleur par point
+// Niveaux 1..3 : grilles de 64^3, 32^3 et 16^3 voxels, un point par voxel
+// non vide a la couleur moyenne ponderee par le nombre de pixels, et un
+// rayon qui croit avec ce nombre
+// Chaque niveau est trie par nombre de pixels decroissant : seul le prefixe
+// des points d'au moins threshold pixels est affiche (longueur du nuage),
+// changer le seuil ne reconstruit rien
+// Un seul niveau est affiche pour tout le nuage : pas de raffinement local
+// pres de la camera ou de la cible de l'orbite
+//------------------------------------------------------------------------------
+#define LOD_LEVELS		4
+#define LOD_GRID_BITS		6	// 64^3 au niveau 1
+#define LOD_REFERENCE_DISTANCE	3.0
+
+typedef struct COLOR_LOD {
+	point_cloud *	clouds[LOD_LEVELS];
+	unsigned char *	radius[LOD_LEVELS];	// rayon en pixels (0 : un pixel)
+	mfloat_t	model[MAT4_SIZE];	// recopie dans le niveau choisi
+	unsigned int *	counts[LOD_LEVELS];	// pixels par point, decroissant
+	int		sizes[LOD_LEVELS];	// nombre de points sans seuil
+	int		colors;			// nombre total de couleurs du niveau 0
+} COLOR_LOD;
+
+
+//------------------------------------------------------------------------------
+// Construction des niveaux a partir de l'histogramme des couleurs
+// Les coordonnees sont celles du cube RGB [-1, 1]^3 (r / 128 - 1)
+//------------------------------------------------------------------------------
+COLOR_LOD *create_color_lod(COLORS_HISTOGRAM *histogram, int threshold);
+void free_color_lod(COLOR_LOD *lod);
+
+//------------------------------------------------------------------------------
+// Nouveau seuil de tous les niveaux : recherche dichotomique de la longueur
+// du prefixe affiche. Retourne le nombre de couleurs affichees au niveau 0.
+//------------------------------------------------------------------------------
+int set_color_lod_threshold(COLOR_LOD *lod, int threshold);
+
+//------------------------------------------------------------------------------
+// Niveau unique pour tout le nuage : le plus fin qui tient dans budget
+// points, au moins un niveau plus grossier a chaque doublement de la
+// distance de la camera au-dela de LOD_REFERENCE_DISTANCE. Retourne le
+// numero du niveau.
+//------------------------------------------------------------------------------
+int select_color_lod(COLOR_LOD *lod, mfloat_t distance, int budget);
+
+
+
+//------------------------------------------------------------------------------
+// Nuage des couleurs construit pendant le comptage : les histogrammes de
+// bandes de lignes sont fusionnes par morceaux dans une table couleur ->
+// nombre de pixels, une couleur entre dans le nuage quand son compte atteint
+// le seuil
+//------------------------------------------------------------------------------
+typedef struct COLOR_STREAM {
+	point_cloud *		cloud;
+	int			threshold;
+	unsigned int *		keys;		// couleur + 1, 0 : case libre
+	unsigned int *		counts;
+	int			capacity;	// puissance de 2
+	int			colors;		// couleurs distinctes vues
+	COLORS_HISTOGRAM **	pending;	// bandes a fusionner
+	int			pending_count;
+	int			pending_capacity;
+	unsigned int		position;	// dans pending[0]
+} COLOR_STREAM;
+
+COLOR_STREAM *create_color_stream(int threshold);
+void free_color_stream(COLOR_STREAM *stream);
+
+// La bande appartient au flux jusqu'a sa fusion
+int add_color_stream_band(COLOR_STREAM *stream, COLORS_HISTOGRAM *band);
+
+// Fusion d'au plus max_entries couleurs en attente, retourne le nombre fusionne
+int merge_color_stream(COLOR_STREAM *stream, int max_entries);
+
+#endif
@@ -1,3 +1,7 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include "pixel.h"
 // TODO threshold
 
@@ -11,6 +15,13 @@
 #include <map.h>
 #include <float.h>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 #define min(a, b) (((a) < (b)) ? (a) : (b))
@@ -19,6 +30,57 @@
 #define max_f(a, b, c)  (fmaxf(a, fmaxf(b, c)))
 
 
+void *aligned_malloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void *ptr;
+
+	if (posix_memalign(&ptr, alignment, size) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+
+
+void aligned_free(void *ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+
+
+//------------------------------------------------------------------------------
+// RGB -> ARGB8888 : 4 pixels (12 octets) par pshufb, l'alpha est ajoute par
+// un ou. La lecture de 16 octets demande 2 pixels de marge apres le groupe.
+//------------------------------------------------------------------------------
+void pixels_to_argb(const PIXEL *pixels, unsigned int *argb, int n)
+{
+	int i = 0;
+	const unsigned char *src = (const unsigned char *)pixels;
+
+#ifdef __SSSE3__
+	const __m128i mask = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i alpha = _mm_set1_epi32(0xFF000000);
+	for (; i + 6 <= n; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * i));
+		_mm_storeu_si128((__m128i *)(argb + i), _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha));
+	}
+#endif
+
+	for (; i < n; i++) {
+		argb[i] = 0xFF000000u | (src[3 * i] << 16) | (src[3 * i + 1] << 8) | src[3 * i + 2];
+	}
+}
+
+
+
 unsigned short flr(double x)
 {
 	return (unsigned short)x - (x < (unsigned short)x);
@@ -256,36 +318,51 @@ void find_closest_color_rgb(PIXEL *pixel, PALETTE *palette, RGB_COLOR *color)
 
 
 //------------------------------------------------------------------------------
-// Retourne un pointeur sur une nouvelle image redimensionnee width*height
+// Allocation d'une image hors pool, pixels non initialises
 //------------------------------------------------------------------------------
-IMAGE *bilinear_resize(IMAGE *image, unsigned short width, unsigned short height)
+IMAGE *alloc_image(int w, int h)
 {
-	unsigned short x_l, y_l, x_h, y_h;
-	float x_weight, y_weight;
+	IMAGE *image = (IMAGE *)malloc(sizeof(IMAGE));
 
-	PIXEL pixel, a, b, c, d;
+	if (image == NULL) {
+		fprintf(stderr, "Impossible de créer la structure IMAGE\n");
+		return NULL;
+	}
 
-	IMAGE *resized = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * width * height);
+	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * w * h);
 
-	resized->pixels = pixels;
-	resized->width = width;
-	resized->height = height;
+	if (pixels == NULL) {
+		fprintf(stderr, "Impossible de créer le tableau de PIXEL\n");
+		free(image);
+		return NULL;
+	}
 
+	image->width = w;
+	image->height = h;
+	image->pixels = pixels;
+	image->pool = NULL;
+
+	return image;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Redimensionne image dans resized (taille resized->width*resized->height)
+//------------------------------------------------------------------------------
+void bilinear_resize_into(IMAGE *image, IMAGE *resized)
+{
+	unsigned short x_l, y_l, x_h, y_h;
+	float x_weight, y_weight;
+	unsigned short width = resized->width;
+	unsigned short height = resized->height;
+
+	PIXEL pixel, a, b, c, d;
 
 	float x_ratio = width > 1 ? ((float)(image->width - 1) / (width - 1)) : 0;
 	float y_ratio = height > 1 ? ((float)(image->height - 1) / (height - 1)) : 0;
 
-	// short percent = 0, old_percent = 0;
-
 	for (unsigned short i = 0; i < height; i++) {
-		/*
-		 * percent = (int)((i / (float)height) * 100);
-		 * if (percent != old_percent)
-		 *      printf("Progression %d\n", percent);
-		 * old_percent = percent;
-		 */
-
 		for (unsigned short j = 0; j < width; j++) {
 			x_l = flr(x_ratio * j);
 			y_l = flr(y_ratio * i);
@@ -318,73 +395,90 @@ IMAGE *bilinear_resize(IMAGE *image, unsigned short width, unsigned short height
 			resized->pixels[i * width + j] = pixel;
 		}
 	}
+}
+
+
+
+//------------------------------------------------------------------------------
+// Retourne un pointeur sur une nouvelle image redimensionnee width*height
+//------------------------------------------------------------------------------
+IMAGE *bilinear_resize(IMAGE *image, unsigned short width, unsigned short height)
+{
+	IMAGE *resized = alloc_image(width, height);
 
+	if (resized)
+		bilinear_resize_into(image, resized);
 	return resized;
 }
 
 
 
-IMAGE *gamma(IMAGE *image, float gamma)
+//------------------------------------------------------------------------------
+// Applique une table de correspondance sur chaque composante
+// dest peut etre l'image source
+//------------------------------------------------------------------------------
+static void apply_lut(IMAGE *image, const unsigned char lut[256], IMAGE *dest)
 {
-	PIXEL pixel, p;
+	int size = image->width * image->height;
 
-	IMAGE *gamma_img = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * image->width * image->height);
+	for (int i = 0; i < size; i++) {
+		PIXEL p = image->pixels[i];
 
-	float gamma_correction;
+		p.r = lut[p.r];
+		p.g = lut[p.g];
+		p.b = lut[p.b];
+		dest->pixels[i] = p;
+	}
+}
 
-	gamma_img->pixels = pixels;
-	gamma_img->width = image->width;
-	gamma_img->height = image->height;
 
-	for (unsigned short y = 0; y < image->height; y++) {
-		for (unsigned short x = 0; x < image->width; x++) {
-			p = image->pixels[y * image->width + x];
 
-			gamma_correction = 1.0 / gamma;
-			p.r = 255 * powf((p.r / 255.0), gamma_correction);
-			p.g = 255 * powf((p.g / 255.0), gamma_correction);
-			p.b = 255 * powf((p.b / 255.0), gamma_correction);
+void gamma_into(IMAGE *image, float gamma, IMAGE *dest)
+{
+	unsigned char lut[256];
+	float gamma_correction = 1.0 / gamma;
 
-			gamma_img->pixels[y * image->width + x] = p;
-		}
-	}
+	for (int i = 0; i < 256; i++)
+		lut[i] = 255 * powf((i / 255.0), gamma_correction);
 
-	return gamma_img;
+	apply_lut(image, lut, dest);
 }
 
 
-IMAGE *brightness_and_contrast(IMAGE *image, float brightness, float contrast)
+
+IMAGE *gamma(IMAGE *image, float gamma)
 {
-	PIXEL pixel, p;
+	IMAGE *gamma_img = alloc_image(image->width, image->height);
 
-	IMAGE *br_ctr_img = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * image->width * image->height);
+	if (gamma_img)
+		gamma_into(image, gamma, gamma_img);
+	return gamma_img;
+}
 
-	int r, g, b;
 
-	br_ctr_img->pixels = pixels;
-	br_ctr_img->width = image->width;
-	br_ctr_img->height = image->height;
 
-	for (unsigned short y = 0; y < image->height; y++) {
-		for (unsigned short x = 0; x < image->width; x++) {
-			p = image->pixels[y * image->width + x];
+void brightness_and_contrast_into(IMAGE *image, float brightness, float contrast, IMAGE *dest)
+{
+	unsigned char lut[256];
+	int v;
 
-			r = (int)round(contrast * (p.r - 128.0) + 128.0 + brightness);
-			g = (int)round(contrast * (p.g - 128.0) + 128.0 + brightness);
-			b = (int)round(contrast * (p.b - 128.0) + 128.0 + brightness);
+	for (int i = 0; i < 256; i++) {
+		v = (int)round(contrast * (i - 128.0) + 128.0 + brightness);
+		v = v > 255 ? 255 : v;
+		lut[i] = v < 0 ? 0 : v;
+	}
 
-			r = r > 255 ? 255 : r;
-			g = g > 255 ? 255 : g;
-			b = b > 255 ? 255 : b;
+	apply_lut(image, lut, dest);
+}
 
-			p.r = r < 0 ? 0 : r;
-			p.g = g < 0 ? 0 : g;
-			p.b = b < 0 ? 0 : b;
-			br_ctr_img->pixels[y * image->width + x] = p;
-		}
-	}
+
+
+IMAGE *brightness_and_contrast(IMAGE *image, float brightness, float contrast)
+{
+	IMAGE *br_ctr_img = alloc_image(image->width, image->height);
+
+	if (br_ctr_img)
+		brightness_and_contrast_into(image, brightness, contrast, br_ctr_img);
 	return br_ctr_img;
 }
 
@@ -393,46 +487,46 @@ IMAGE *brightness_and_contrast(IMAGE *image, float brightness, float contrast)
 //------------------------------------------------------------------------------
 // saturation l'image
 //------------------------------------------------------------------------------
-IMAGE *saturation(IMAGE *image, float sat)
+void saturation_into(IMAGE *image, float sat, IMAGE *dest)
 {
-	PIXEL pixel, p;
-
-	IMAGE *sat_img = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * image->width * image->height);
-
+	PIXEL p;
 	float r, g, b;
-	float gray;
-
 
 	float Pr = 0.299f;
 	float Pg = 0.587f;
 	float Pb = 0.114f;
 
-	sat_img->pixels = pixels;
-	sat_img->width = image->width;
-	sat_img->height = image->height;
+	int size = image->width * image->height;
 
-	for (unsigned short y = 0; y < image->height; y++) {
-		for (unsigned short x = 0; x < image->width; x++) {
-			p = image->pixels[y * image->width + x];
+	for (int i = 0; i < size; i++) {
+		p = image->pixels[i];
 
-			double P = sqrt(p.r * p.r * Pr + p.g * p.g * Pg + p.b * p.b * Pb);
+		double P = sqrt(p.r * p.r * Pr + p.g * p.g * Pg + p.b * p.b * Pb);
 
-			r = P + (p.r - P) * sat;
-			g = P + (p.g - P) * sat;
-			b = P + (p.b - P) * sat;
+		r = P + (p.r - P) * sat;
+		g = P + (p.g - P) * sat;
+		b = P + (p.b - P) * sat;
 
-			r = r > 255 ? 255 : r;
-			g = g > 255 ? 255 : g;
-			b = b > 255 ? 255 : b;
+		r = r > 255 ? 255 : r;
+		g = g > 255 ? 255 : g;
+		b = b > 255 ? 255 : b;
 
-			p.r = r < 0 ? 0 : r;
-			p.g = g < 0 ? 0 : g;
-			p.b = b < 0 ? 0 : b;
+		p.r = r < 0 ? 0 : r;
+		p.g = g < 0 ? 0 : g;
+		p.b = b < 0 ? 0 : b;
 
-			sat_img->pixels[y * image->width + x] = p;
-		}
+		dest->pixels[i] = p;
 	}
+}
+
+
+
+IMAGE *saturation(IMAGE *image, float sat)
+{
+	IMAGE *sat_img = alloc_image(image->width, image->height);
+
+	if (sat_img)
+		saturation_into(image, sat, sat_img);
 	return sat_img;
 }
 
@@ -441,23 +535,19 @@ IMAGE *saturation(IMAGE *image, float sat)
 
 IMAGE *create_image(unsigned char *pixs, PALETTE *palette, int w, int h)
 {
-	IMAGE *image = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * w * h);
+	IMAGE *image = alloc_image(w, h);
 
-	// int r, g, b;
+	if (image == NULL)
+		return NULL;
 
 	for (int y = 0; y < h; y++) {
 		for (int x = 0; x < w; x++) {
-			pixels[y * w + x].r = palette->colors[pixs[y * w + x]][0];
-			pixels[y * w + x].g = palette->colors[pixs[y * w + x]][1];
-			pixels[y * w + x].b = palette->colors[pixs[y * w + x]][2];
+			image->pixels[y * w + x].r = palette->colors[pixs[y * w + x]][0];
+			image->pixels[y * w + x].g = palette->colors[pixs[y * w + x]][1];
+			image->pixels[y * w + x].b = palette->colors[pixs[y * w + x]][2];
 		}
 	}
 
-	image->width = w;
-	image->height = h;
-	image->pixels = pixels;
-
 	return image;
 }
 
@@ -465,90 +555,56 @@ IMAGE *create_image(unsigned char *pixs, PALETTE *palette, int w, int h)
 
 IMAGE *create_empty_image(int w, int h)
 {
-	IMAGE *image = (IMAGE *)malloc(sizeof(IMAGE));
-
-	if (image == NULL) {
-		fprintf(stderr, "Impossible de créer la structure IMAGE\n");
-		return NULL;
-	}
-
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * w * h);
-
-	if (pixels == NULL) {
-		fprintf(stderr, "Impossible de créer le tableau de PIXEL\n");
-		return NULL;
-	}
-
-
-	// int r, g, b;
-
-	for (int y = 0; y < h; y++) {
-		for (int x = 0; x < w; x++) {
-			pixels[y * w + x].r = 0;
-			pixels[y * w + x].g = 0;
-			pixels[y * w + x].b = 0;
-		}
-	}
-
-	image->width = w;
-	image->height = h;
-	image->pixels = pixels;
+	IMAGE *image = alloc_image(w, h);
 
+	if (image)
+		memset(image->pixels, 0, sizeof(PIXEL) * w * h);
 	return image;
 }
 
 
 
-IMAGE *convert_rgb_image_to_linear(IMAGE *image)
+void convert_rgb_image_to_linear_into(IMAGE *image, IMAGE *dest)
 {
-	IMAGE *linear_img = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * image->width * image->height);
+	unsigned char lut[256];
 
-	linear_img->pixels = pixels;
-	linear_img->width = image->width;
-	linear_img->height = image->height;
+	for (int i = 0; i < 256; i++)
+		lut[i] = (int)round(linear_space_f(i));
 
-	PIXEL p;
+	apply_lut(image, lut, dest);
+}
 
-	for (unsigned short y = 0; y < image->height; y++) {
-		for (unsigned short x = 0; x < image->width; x++) {
-			p = image->pixels[y * image->width + x];
 
-			p.r = (int)round(linear_space_f(p.r));
-			p.g = (int)round(linear_space_f(p.g));
-			p.b = (int)round(linear_space_f(p.b));
 
-			linear_img->pixels[y * image->width + x] = p;
-		}
-	}
+IMAGE *convert_rgb_image_to_linear(IMAGE *image)
+{
+	IMAGE *linear_img = alloc_image(image->width, image->height);
 
+	if (linear_img)
+		convert_rgb_image_to_linear_into(image, linear_img);
 	return linear_img;
 }
 
 
-IMAGE *convert_linear_image_to_rgb(IMAGE *image)
+
+void convert_linear_image_to_rgb_into(IMAGE *image, IMAGE *dest)
 {
-	IMAGE *rgb_img = (IMAGE *)malloc(sizeof(IMAGE));
-	PIXEL *pixels = (PIXEL *)malloc(sizeof(PIXEL) * image->width * image->height);
+	unsigned char lut[256];
 
-	rgb_img->pixels = pixels;
-	rgb_img->width = image->width;
-	rgb_img->height = image->height;
+	for (int i = 0; i < 256; i++)
+		lut[i] = (int)round(rgb_space_f(i));
 
-	PIXEL p;
+	apply_lut(image, lut, dest);
+}
 
-	for (unsigned short y = 0; y < image->height; y++) {
-		for (unsigned short x = 0; x < image->width; x++) {
-			p = image->pixels[y * image->width + x];
 
-			p.r = (int)round(rgb_space_f(p.r));
-			p.g = (int)round(rgb_space_f(p.g));
-			p.b = (int)round(rgb_space_f(p.b));
 
-			rgb_img->pixels[y * image->width + x] = p;
-		}
-	}
+IMAGE *convert_linear_image_to_rgb(IMAGE *image)
+{
+	IMAGE *rgb_img = alloc_image(image->width, image->height);
 
+	if (rgb_img)
+		convert_linear_image_to_rgb_into(image, rgb_img);
 	return rgb_img;
 }
 
@@ -575,6 +631,192 @@ unsigned char *create_pixels_array(IMAGE *image, PALETTE *palette)
 
 
 
+//------------------------------------------------------------------------------
+// Recherche de la couleur la plus proche en arithmetique entiere
+// (meme ponderation 30/59/11 que color_delta_f, sans la racine)
+//------------------------------------------------------------------------------
+static inline int closest_index_int(int r, int g, int b, PALETTE *palette)
+{
+	int d, dr, dg, db;
+	int diff = INT_MAX;
+	int plt = 0;
+
+	for (int i = 0; i < palette->size; i++) {
+		dr = palette->colors[i][0] - r;
+		dg = palette->colors[i][1] - g;
+		db = palette->colors[i][2] - b;
+		d = 30 * dr * dr + 59 * dg * dg + 11 * db * db;
+		if (d < diff) {
+			plt = i;
+			diff = d;
+		}
+	}
+	return plt;
+}
+
+
+static inline int clamp_255(int x)
+{
+	return x < 0 ? 0 : (x > 255 ? 255 : x);
+}
+
+
+//------------------------------------------------------------------------------
+// Floyd-Steinberg en serpentin
+// Les erreurs sont stockees en virgule fixe (4 bits de fraction) dans deux
+// lignes tampon decalees d'une case pour eviter les tests de bord
+//------------------------------------------------------------------------------
+static void dither_floyd_steinberg(IMAGE *image, PALETTE *palette, unsigned char *pixels)
+{
+	int w = image->width;
+	int h = image->height;
+	int *err_cur = calloc((w + 2) * 3, sizeof(int));
+	int *err_next = calloc((w + 2) * 3, sizeof(int));
+	int *tmp;
+
+	if (!err_cur || !err_next) {
+		free(err_cur);
+		free(err_next);
+		return;
+	}
+
+	for (int y = 0; y < h; y++) {
+		int dir = (y & 1) ? -1 : 1;
+		int x = (y & 1) ? w - 1 : 0;
+
+		memset(err_next, 0, (w + 2) * 3 * sizeof(int));
+
+		for (int n = 0; n < w; n++, x += dir) {
+			PIXEL *p = &image->pixels[y * w + x];
+			int *e = &err_cur[(x + 1) * 3];
+			int *en = &err_next[(x + 1) * 3];
+			int c[3];
+
+			c[0] = clamp_255(p->r + ((e[0] + 8) >> 4));
+			c[1] = clamp_255(p->g + ((e[1] + 8) >> 4));
+			c[2] = clamp_255(p->b + ((e[2] + 8) >> 4));
+
+			int idx = closest_index_int(c[0], c[1], c[2], palette);
+			pixels[y * w + x] = idx;
+
+			for (int i = 0; i < 3; i++) {
+				int q = c[i] - palette->colors[idx][i];
+				// 7/16 devant, 3/16 derriere-dessous, 5/16 dessous, 1/16 devant-dessous
+				e[dir * 3 + i] += q * 7;
+				en[-dir * 3 + i] += q * 3;
+				en[i] += q * 5;
+				en[dir * 3 + i] += q;
+			}
+		}
+
+		tmp = err_cur;
+		err_cur = err_next;
+		err_next = tmp;
+	}
+
+	free(err_cur);
+	free(err_next);
+}
+
+
+//------------------------------------------------------------------------------
+// Matrice de Bayer 8x8
+//------------------------------------------------------------------------------
+static const unsigned char bayer_8x8[8][8] = {
+	{ 0,  32, 8,  40, 2,  34, 10, 42 },
+	{ 48, 16, 56, 24, 50, 18, 58, 26 },
+	{ 12, 44, 4,  36, 14, 46, 6,  38 },
+	{ 60, 28, 52, 20, 62, 30, 54, 22 },
+	{ 3,  35, 11, 43, 1,  33, 9,  41 },
+	{ 51, 19, 59, 27, 49, 17, 57, 25 },
+	{ 15, 47, 7,  39, 13, 45, 5,  37 },
+	{ 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+
+//------------------------------------------------------------------------------
+// Tramage ordonne, les lignes sont independantes et traitees en parallele
+// L'amplitude du bruit est la moitie de la distance moyenne entre une
+// couleur de la palette et sa plus proche voisine
+//------------------------------------------------------------------------------
+static void dither_bayer(IMAGE *image, PALETTE *palette, unsigned char *pixels)
+{
+	int w = image->width;
+	int h = image->height;
+	int offsets[64];
+	float spread = 0;
+
+	for (int i = 0; i < palette->size; i++) {
+		float nearest = FLT_MAX;
+		for (int j = 0; j < palette->size; j++) {
+			if (i == j)
+				continue;
+			float dr = palette->colors[i][0] - palette->colors[j][0];
+			float dg = palette->colors[i][1] - palette->colors[j][1];
+			float db = palette->colors[i][2] - palette->colors[j][2];
+			nearest = fminf(nearest, sqrtf(dr * dr + dg * dg + db * db));
+		}
+		spread += (nearest == FLT_MAX ? 0 : nearest);
+	}
+	spread = palette->size > 0 ? spread / palette->size / 2 : 0;
+
+	for (int i = 0; i < 64; i++)
+		offsets[i] = (int)lroundf(((2 * i + 1) - 64) / 128.0f * spread);
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < h; y++) {
+		const unsigned char *bayer_row = bayer_8x8[y & 7];
+		for (int x = 0; x < w; x++) {
+			PIXEL *p = &image->pixels[y * w + x];
+			int o = offsets[bayer_row[x & 7]];
+			pixels[y * w + x] = closest_index_int(clamp_255(p->r + o),
+							      clamp_255(p->g + o),
+							      clamp_255(p->b + o), palette);
+		}
+	}
+}
+
+
+
+unsigned char *create_pixels_array_dither(IMAGE *image, PALETTE *palette, int mode)
+{
+	unsigned char *pixels;
+
+	if (mode == DITHER_NONE)
+		return create_pixels_array(image, palette);
+
+	pixels = malloc(sizeof(unsigned char) * image->height * image->width);
+	if (!pixels) {
+		printf("Pas assez de memoire\n");
+		return NULL;
+	}
+
+	if (mode == DITHER_FLOYD_STEINBERG)
+		dither_floyd_steinberg(image, palette, pixels);
+	else
+		dither_bayer(image, palette, pixels);
+
+	return pixels;
+}
+
+
+
+IMAGE *dither_image(IMAGE *image, PALETTE *palette, int mode)
+{
+	unsigned char *pixels = create_pixels_array_dither(image, palette, mode);
+	IMAGE *dithered;
+
+	if (!pixels)
+		return NULL;
+
+	dithered = create_image(pixels, palette, image->width, image->height);
+	free(pixels);
+
+	return dithered;
+}
+
+
+
 
 
 
@@ -682,3 +924,104 @@ void get_colors_map(IMAGE *image, map *colors)
 		}
 	}
 }
+
+
+
+COLORS_HISTOGRAM *create_colors_histogram_from_keys(unsigned int *keys, unsigned int n)
+{
+	COLORS_HISTOGRAM *histogram = (COLORS_HISTOGRAM *)malloc(sizeof(COLORS_HISTOGRAM));
+	unsigned int *tmp = (unsigned int *)malloc(sizeof(unsigned int) * n);
+	unsigned int *buckets = (unsigned int *)malloc(sizeof(unsigned int) * 4096);
+	unsigned int *src = keys, *dst = tmp, *swap;
+	unsigned int unique = 0;
+
+	if (!histogram || !tmp || !buckets) {
+		fprintf(stderr, "Impossible de créer l'histogramme\n");
+		free(histogram);
+		free(tmp);
+		free(buckets);
+		return NULL;
+	}
+
+	// Tri par base en 2 passes de 12 bits, les cles triees reviennent dans keys
+	for (int shift = 0; shift < 24; shift += 12) {
+		unsigned int sum = 0;
+
+		memset(buckets, 0, sizeof(unsigned int) * 4096);
+		for (unsigned int i = 0; i < n; i++)
+			buckets[(src[i] >> shift) & 0xFFF]++;
+		for (int i = 0; i < 4096; i++) {
+			unsigned int c = buckets[i];
+			buckets[i] = sum;
+			sum += c;
+		}
+		for (unsigned int i = 0; i < n; i++)
+			dst[buckets[(src[i] >> shift) & 0xFFF]++] = src[i];
+
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	free(buckets);
+
+	for (unsigned int i = 0; i < n; i++)
+		if (i == 0 || keys[i] != keys[i - 1])
+			unique++;
+
+	histogram->size = unique;
+	histogram->colors = (unsigned int *)malloc(sizeof(unsigned int) * unique);
+	histogram->counts = (unsigned int *)malloc(sizeof(unsigned int) * unique);
+
+	if (!histogram->colors || !histogram->counts) {
+		fprintf(stderr, "Impossible de créer l'histogramme\n");
+		free_colors_histogram(histogram);
+		free(tmp);
+		return NULL;
+	}
+
+	unique = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		if (i == 0 || keys[i] != keys[i - 1]) {
+			histogram->colors[unique] = keys[i];
+			histogram->counts[unique] = 0;
+			unique++;
+		}
+		histogram->counts[unique - 1]++;
+	}
+
+	free(tmp);
+	return histogram;
+}
+
+
+
+COLORS_HISTOGRAM *create_colors_histogram(IMAGE *image)
+{
+	unsigned int n = image->width * image->height;
+	unsigned int *keys = (unsigned int *)malloc(sizeof(unsigned int) * n);
+	COLORS_HISTOGRAM *histogram;
+
+	if (!keys) {
+		fprintf(stderr, "Impossible de créer l'histogramme\n");
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i < n; i++)
+		keys[i] = (image->pixels[i].r << 16) | (image->pixels[i].g << 8) | image->pixels[i].b;
+
+	histogram = create_colors_histogram_from_keys(keys, n);
+	free(keys);
+
+	return histogram;
+}
+
+
+
+void free_colors_histogram(COLORS_HISTOGRAM *histogram)
+{
+	if (histogram) {
+		free(histogram->colors);
+		free(histogram->counts);
+		free(histogram);
+	}
+}
@@ -16,10 +16,16 @@ typedef struct PIXEL_STRUCT PIXEL;
 
 
 
+struct IMAGE_POOL_STRUCT;
+
+//------------------------------------------------------------------------------
+// pool est non NULL si les pixels proviennent d'un IMAGE_POOL (voir pool.h)
+//------------------------------------------------------------------------------
 struct IMAGE_STRUCT {
-	unsigned short	width;
-	unsigned short	height;
-	PIXEL *		pixels;
+	unsigned short			width;
+	unsigned short			height;
+	PIXEL *				pixels;
+	struct IMAGE_POOL_STRUCT *	pool;
 };
 typedef struct IMAGE_STRUCT IMAGE;
 
@@ -47,10 +53,42 @@ struct PALETTE_IMAGE_STRUCT {
 typedef struct PALETTE_IMAGE_STRUCT PALETTE_IMAGE;
 
 
+//------------------------------------------------------------------------------
+// Histogramme des couleurs 24 bits (0xRRGGBB) triees par valeur croissante
+//------------------------------------------------------------------------------
+struct COLORS_HISTOGRAM_STRUCT {
+	unsigned int	size;
+	unsigned int *	colors;
+	unsigned int *	counts;
+};
+typedef struct COLORS_HISTOGRAM_STRUCT COLORS_HISTOGRAM;
+
+
 typedef unsigned char RGB_COLOR[3];
 typedef unsigned char INDEXED_COLOR;
 
 
+//------------------------------------------------------------------------------
+// Modes de tramage pour la conversion vers une palette
+//------------------------------------------------------------------------------
+#define DITHER_NONE		0
+#define DITHER_FLOYD_STEINBERG	1
+#define DITHER_BAYER		2
+
+
+
+//------------------------------------------------------------------------------
+// Allocation alignee (liberer avec aligned_free)
+//------------------------------------------------------------------------------
+void *aligned_malloc(size_t size, size_t alignment);
+void aligned_free(void *ptr);
+
+
+//------------------------------------------------------------------------------
+// Expansion de n pixels RGB en mots 32 bits 0xFFRRGGBB (ARGB8888)
+//------------------------------------------------------------------------------
+void pixels_to_argb(const PIXEL *pixels, unsigned int *argb, int n);
+
 
 //------------------------------------------------------------------------------
 // Conversion rgb<->cie linéaire
@@ -126,11 +164,19 @@ IMAGE *create_image(unsigned char *pixels, PALETTE *palette, int w, int h);
 //------------------------------------------------------------------------------
 IMAGE *create_empty_image(int w, int h);
 
+//------------------------------------------------------------------------------
+// Creation struct IMAGE hors pool, pixels non initialises
+//------------------------------------------------------------------------------
+IMAGE *alloc_image(int w, int h);
+
 //------------------------------------------------------------------------------
 // Conversion images
+// Les variantes _into ecrivent dans dest (meme taille, peut etre image)
 //------------------------------------------------------------------------------
 IMAGE *convert_rgb_image_to_linear(IMAGE *image);
 IMAGE *convert_linear_image_to_rgb(IMAGE *image);
+void convert_rgb_image_to_linear_into(IMAGE *image, IMAGE *dest);
+void convert_linear_image_to_rgb_into(IMAGE *image, IMAGE *dest);
 
 
 //------------------------------------------------------------------------------
@@ -138,26 +184,45 @@ IMAGE *convert_linear_image_to_rgb(IMAGE *image);
 //------------------------------------------------------------------------------
 unsigned char *create_pixels_array(IMAGE *image, PALETTE *palette);
 
+//------------------------------------------------------------------------------
+// Creation d'un tableau de pixels tramé (DITHER_NONE, DITHER_FLOYD_STEINBERG
+// ou DITHER_BAYER) à partir d'une struct IMAGE
+//------------------------------------------------------------------------------
+unsigned char *create_pixels_array_dither(IMAGE *image, PALETTE *palette, int mode);
+
+//------------------------------------------------------------------------------
+// Retourne une nouvelle image tramée avec les couleurs de la palette
+//------------------------------------------------------------------------------
+IMAGE *dither_image(IMAGE *image, PALETTE *palette, int mode);
+
 
 //------------------------------------------------------------------------------
 // Redimensionnement de l'image
 //------------------------------------------------------------------------------
 IMAGE *bilinear_resize(IMAGE *image, unsigned short width, unsigned short height);
 
+//------------------------------------------------------------------------------
+// Redimensionnement vers resized (taille resized->width * resized->height)
+//------------------------------------------------------------------------------
+void bilinear_resize_into(IMAGE *image, IMAGE *resized);
+
 //------------------------------------------------------------------------------
 // gamma de l'image
 //------------------------------------------------------------------------------
 IMAGE *gamma(IMAGE *image, float gamma);
+void gamma_into(IMAGE *image, float gamma, IMAGE *dest);
 
 //------------------------------------------------------------------------------
 // luminosite et contraste de l'image
 //------------------------------------------------------------------------------
 IMAGE *brightness_and_contrast(IMAGE *image, float brightness, float contrast);
+void brightness_and_contrast_into(IMAGE *image, float brightness, float contrast, IMAGE *dest);
 
 //------------------------------------------------------------------------------
 // saturation des couleurs
 //------------------------------------------------------------------------------
 IMAGE *saturation(IMAGE *image, float sat);
+void saturation_into(IMAGE *image, float sat, IMAGE *dest);
 
 
 //------------------------------------------------------------------------------
@@ -183,4 +248,17 @@ int load_hex_palette(char *filename, PALETTE *palette);
 //------------------------------------------------------------------------------
 void get_colors_map(IMAGE *image, map *colors);
 
+//------------------------------------------------------------------------------
+// Histogramme des couleurs de l'image (tri par base sur les couleurs 24 bits)
+// A l'appelant de liberer la memoire avec free_colors_histogram
+//------------------------------------------------------------------------------
+COLORS_HISTOGRAM *create_colors_histogram(IMAGE *image);
+
+//------------------------------------------------------------------------------
+// Histogramme a partir de n couleurs 24 bits, le tableau keys est trie
+// sur place
+//------------------------------------------------------------------------------
+COLORS_HISTOGRAM *create_colors_histogram_from_keys(unsigned int *keys, unsigned int n);
+void free_colors_histogram(COLORS_HISTOGRAM *histogram);
+
 #endif
@@ -0,0 +1,353 @@
+#include "planar.h"
+#include "pool.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+
+#define ALIGN_UP(x, a)	(((x) + (a) - 1) / (a) * (a))
+#define MIN(x, y)	(((x) < (y)) ? (x) : (y))
+
+
+
+PLANAR_IMAGE *create_planar_image(int w, int h)
+{
+	PLANAR_IMAGE *image = (PLANAR_IMAGE *)malloc(sizeof(PLANAR_IMAGE));
+
+	if (image == NULL) {
+		fprintf(stderr, "Impossible de créer la structure PLANAR_IMAGE\n");
+		return NULL;
+	}
+
+	int stride = ALIGN_UP(w > 0 ? w : 1, PLANAR_ALIGN);
+	size_t plane_size = (size_t)stride * h;
+	unsigned char *planes = (unsigned char *)aligned_malloc(3 * plane_size, PLANAR_ALIGN);
+
+	if (planes == NULL) {
+		fprintf(stderr, "Impossible de créer les plans de l'image\n");
+		free(image);
+		return NULL;
+	}
+	memset(planes, 0, 3 * plane_size);
+
+	image->width = w;
+	image->height = h;
+	image->stride = stride;
+	image->r = planes;
+	image->g = planes + plane_size;
+	image->b = planes + 2 * plane_size;
+	image->pool = NULL;
+
+	return image;
+}
+
+
+
+void free_planar_image(PLANAR_IMAGE *image)
+{
+	if (image && image->pool) {
+		pool_release_planar_image(image);
+	} else if (image) {
+		aligned_free(image->r);
+		free(image);
+	}
+}
+
+
+
+#ifdef __SSSE3__
+//------------------------------------------------------------------------------
+// Masques pshufb pour 16 pixels (48 octets) <-> 3 x 16 octets
+//------------------------------------------------------------------------------
+static const signed char deinterleave_masks[3][3][16] = {
+	{ { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 } },
+	{ { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 } },
+	{ { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+	  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 } }
+};
+
+static const signed char interleave_masks[3][3][16] = {
+	{ { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+	  { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+	  { -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 } },
+	{ { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+	  { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+	  { -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 } },
+	{ { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+	  { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+	  { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 } }
+};
+
+#define MASK(m)	_mm_loadu_si128((const __m128i *)(m))
+#endif
+
+
+
+void convert_image_to_planar(IMAGE *image, PLANAR_IMAGE *planar)
+{
+	int w = image->width;
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < image->height; y++) {
+		const unsigned char *src = (const unsigned char *)&image->pixels[y * w];
+		unsigned char *r = planar->r + y * planar->stride;
+		unsigned char *g = planar->g + y * planar->stride;
+		unsigned char *b = planar->b + y * planar->stride;
+		int x = 0;
+
+#ifdef __SSSE3__
+		for (; x + 16 <= w; x += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+			__m128i c = _mm_loadu_si128((const __m128i *)(src + 3 * x + 16));
+			__m128i d = _mm_loadu_si128((const __m128i *)(src + 3 * x + 32));
+			__m128i *dst[3] = { (__m128i *)(r + x), (__m128i *)(g + x), (__m128i *)(b + x) };
+
+			for (int ch = 0; ch < 3; ch++) {
+				__m128i v = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(a, MASK(deinterleave_masks[ch][0])),
+					_mm_shuffle_epi8(c, MASK(deinterleave_masks[ch][1]))),
+					_mm_shuffle_epi8(d, MASK(deinterleave_masks[ch][2])));
+				_mm_store_si128(dst[ch], v);
+			}
+		}
+#endif
+		for (; x < w; x++) {
+			r[x] = src[3 * x];
+			g[x] = src[3 * x + 1];
+			b[x] = src[3 * x + 2];
+		}
+	}
+}
+
+
+
+void convert_planar_to_image(PLANAR_IMAGE *planar, IMAGE *image)
+{
+	int w = image->width;
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < image->height; y++) {
+		unsigned char *dst = (unsigned char *)&image->pixels[y * w];
+		const unsigned char *r = planar->r + y * planar->stride;
+		const unsigned char *g = planar->g + y * planar->stride;
+		const unsigned char *b = planar->b + y * planar->stride;
+		int x = 0;
+
+#ifdef __SSSE3__
+		for (; x + 16 <= w; x += 16) {
+			__m128i vr = _mm_load_si128((const __m128i *)(r + x));
+			__m128i vg = _mm_load_si128((const __m128i *)(g + x));
+			__m128i vb = _mm_load_si128((const __m128i *)(b + x));
+
+			for (int out = 0; out < 3; out++) {
+				__m128i v = _mm_or_si128(_mm_or_si128(
+					_mm_shuffle_epi8(vr, MASK(interleave_masks[out][0])),
+					_mm_shuffle_epi8(vg, MASK(interleave_masks[out][1]))),
+					_mm_shuffle_epi8(vb, MASK(interleave_masks[out][2])));
+				_mm_storeu_si128((__m128i *)(dst + 3 * x + 16 * out), v);
+			}
+		}
+#endif
+		for (; x < w; x++) {
+			dst[3 * x] = r[x];
+			dst[3 * x + 1] = g[x];
+			dst[3 * x + 2] = b[x];
+		}
+	}
+}
+
+
+
+PLANAR_IMAGE *image_to_planar(IMAGE *image)
+{
+	PLANAR_IMAGE *planar = create_planar_image(image->width, image->height);
+
+	if (planar)
+		convert_image_to_planar(image, planar);
+	return planar;
+}
+
+
+
+IMAGE *planar_to_image(PLANAR_IMAGE *planar)
+{
+	IMAGE *image = create_empty_image(planar->width, planar->height);
+
+	if (image)
+		convert_planar_to_image(planar, image);
+	return image;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Redimensionnement separable en virgule fixe (poids sur 8 bits)
+// Les positions et poids des colonnes sont calcules une seule fois, chaque
+// ligne est interpolee horizontalement puis melangee verticalement
+//------------------------------------------------------------------------------
+static void resize_plane(const unsigned char *src, int src_stride, int src_height, unsigned char *dst, int dst_stride,
+			 int width, int height, const int *x_l, const int *x_h, const int *x_w,
+			 float y_ratio, unsigned short *row_l, unsigned short *row_h)
+{
+	for (int i = 0; i < height; i++) {
+		float y = y_ratio * i;
+		// l'arrondi de y_ratio * i peut depasser la derniere ligne
+		int y_l = MIN((int)y, src_height - 1);
+		int y_h = MIN(y_l + (y > y_l), src_height - 1);
+		int w_y = (int)((y - y_l) * 256.0f + 0.5f);
+		const unsigned char *l = src + y_l * src_stride;
+		const unsigned char *h = src + y_h * src_stride;
+		unsigned char *out = dst + i * dst_stride;
+
+		for (int j = 0; j < width; j++) {
+			row_l[j] = l[x_l[j]] * (256 - x_w[j]) + l[x_h[j]] * x_w[j];
+			row_h[j] = h[x_l[j]] * (256 - x_w[j]) + h[x_h[j]] * x_w[j];
+		}
+		for (int j = 0; j < width; j++)
+			out[j] = (row_l[j] * (256 - w_y) + row_h[j] * w_y + 32768) >> 16;
+	}
+}
+
+
+
+PLANAR_IMAGE *bilinear_resize_planar(PLANAR_IMAGE *image, unsigned short width, unsigned short height)
+{
+	PLANAR_IMAGE *resized = create_planar_image(width, height);
+	int *x_l = (int *)malloc(sizeof(int) * 3 * width);
+	unsigned short *rows = (unsigned short *)malloc(sizeof(unsigned short) * 2 * width);
+
+	if (!resized || !x_l || !rows) {
+		free_planar_image(resized);
+		free(x_l);
+		free(rows);
+		return NULL;
+	}
+
+	int *x_h = x_l + width;
+	int *x_w = x_l + 2 * width;
+	float x_ratio = width > 1 ? ((float)(image->width - 1) / (width - 1)) : 0;
+	float y_ratio = height > 1 ? ((float)(image->height - 1) / (height - 1)) : 0;
+
+	for (int j = 0; j < width; j++) {
+		float x = x_ratio * j;
+		// l'arrondi de x_ratio * j peut depasser la derniere colonne
+		x_l[j] = MIN((int)x, image->width - 1);
+		x_h[j] = MIN(x_l[j] + (x > x_l[j]), image->width - 1);
+		x_w[j] = (int)((x - x_l[j]) * 256.0f + 0.5f);
+	}
+
+	resize_plane(image->r, image->stride, image->height, resized->r, resized->stride, width, height, x_l, x_h, x_w, y_ratio, rows, rows + width);
+	resize_plane(image->g, image->stride, image->height, resized->g, resized->stride, width, height, x_l, x_h, x_w, y_ratio, rows, rows + width);
+	resize_plane(image->b, image->stride, image->height, resized->b, resized->stride, width, height, x_l, x_h, x_w, y_ratio, rows, rows + width);
+
+	free(x_l);
+	free(rows);
+
+	return resized;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Recherche de la couleur la plus proche ligne par ligne : la boucle sur la
+// palette est a l'exterieur pour que la boucle sur les pixels soit
+// vectorisee (distance 30/59/11 comme color_delta_f)
+//------------------------------------------------------------------------------
+unsigned char *create_pixels_array_planar(PLANAR_IMAGE *image, PALETTE *palette)
+{
+	int w = image->width;
+	unsigned char *pixels = malloc(sizeof(unsigned char) * image->height * w);
+
+	if (!pixels) {
+		printf("Pas assez de memoire\n");
+		return NULL;
+	}
+
+	#pragma omp parallel
+	{
+		int *best_d = (int *)aligned_malloc(sizeof(int) * image->stride, PLANAR_ALIGN);
+		unsigned char *best_i = (unsigned char *)aligned_malloc(image->stride, PLANAR_ALIGN);
+
+		#pragma omp for schedule(static)
+		for (int y = 0; y < image->height; y++) {
+			const unsigned char *r = image->r + y * image->stride;
+			const unsigned char *g = image->g + y * image->stride;
+			const unsigned char *b = image->b + y * image->stride;
+
+			for (int x = 0; x < w; x++) {
+				best_d[x] = INT_MAX;
+				best_i[x] = 0;
+			}
+
+			for (int i = 0; i < palette->size; i++) {
+				int pr = palette->colors[i][0];
+				int pg = palette->colors[i][1];
+				int pb = palette->colors[i][2];
+
+				for (int x = 0; x < w; x++) {
+					int dr = r[x] - pr;
+					int dg = g[x] - pg;
+					int db = b[x] - pb;
+					int d = 30 * dr * dr + 59 * dg * dg + 11 * db * db;
+
+					best_i[x] = d < best_d[x] ? i : best_i[x];
+					best_d[x] = d < best_d[x] ? d : best_d[x];
+				}
+			}
+			memcpy(pixels + y * w, best_i, w);
+		}
+
+		aligned_free(best_d);
+		aligned_free(best_i);
+	}
+	return pixels;
+}
+
+
+
+COLORS_HISTOGRAM *create_colors_histogram_planar(PLANAR_IMAGE *image)
+{
+	return create_colors_histogram_planar_rows(image, 0, image->height);
+}
+
+
+
+COLORS_HISTOGRAM *create_colors_histogram_planar_rows(PLANAR_IMAGE *image, int y0, int y1)
+{
+	int w = image->width;
+	unsigned int n = w * (y1 - y0);
+	unsigned int *keys = (unsigned int *)malloc(sizeof(unsigned int) * (n > 0 ? n : 1));
+	COLORS_HISTOGRAM *histogram;
+
+	if (!keys) {
+		fprintf(stderr, "Impossible de créer l'histogramme\n");
+		return NULL;
+	}
+
+	#pragma omp parallel for schedule(static)
+	for (int y = y0; y < y1; y++) {
+		const unsigned char *r = image->r + y * image->stride;
+		const unsigned char *g = image->g + y * image->stride;
+		const unsigned char *b = image->b + y * image->stride;
+		unsigned int *k = keys + (y - y0) * w;
+
+		for (int x = 0; x < w; x++)
+			k[x] = ((unsigned int)r[x] << 16) | ((unsigned int)g[x] << 8) | b[x];
+	}
+
+	histogram = create_colors_histogram_from_keys(keys, n);
+	free(keys);
+
+	return histogram;
+}
@@ -0,0 +1,71 @@
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include "pixel.h"
+
+
+//------------------------------------------------------------------------------
+// Alignement des plans et du pas de ligne (en octets)
+//------------------------------------------------------------------------------
+#define PLANAR_ALIGN	32
+
+struct IMAGE_POOL_STRUCT;
+
+//------------------------------------------------------------------------------
+// Image en plans separes R, G et B
+// Chaque ligne fait stride octets (multiple de PLANAR_ALIGN), les colonnes
+// au dela de width sont du remplissage. Les 3 plans sont dans une seule
+// allocation alignee (venant d'un IMAGE_POOL si pool est non NULL).
+//------------------------------------------------------------------------------
+struct PLANAR_IMAGE_STRUCT {
+	unsigned short			width;
+	unsigned short			height;
+	int				stride;
+	unsigned char *			r;
+	unsigned char *			g;
+	unsigned char *			b;
+	struct IMAGE_POOL_STRUCT *	pool;
+};
+typedef struct PLANAR_IMAGE_STRUCT PLANAR_IMAGE;
+
+
+//------------------------------------------------------------------------------
+// Creation d'une image planaire vide (remplissage a 0)
+// A l'appelant de liberer la memoire avec free_planar_image
+//------------------------------------------------------------------------------
+PLANAR_IMAGE *create_planar_image(int w, int h);
+void free_planar_image(PLANAR_IMAGE *image);
+
+//------------------------------------------------------------------------------
+// Conversion RGB entrelace <-> plans, dans une destination de meme taille
+//------------------------------------------------------------------------------
+void convert_image_to_planar(IMAGE *image, PLANAR_IMAGE *planar);
+void convert_planar_to_image(PLANAR_IMAGE *planar, IMAGE *image);
+
+//------------------------------------------------------------------------------
+// Conversion RGB entrelace <-> plans avec allocation de la destination
+//------------------------------------------------------------------------------
+PLANAR_IMAGE *image_to_planar(IMAGE *image);
+IMAGE *planar_to_image(PLANAR_IMAGE *planar);
+
+//------------------------------------------------------------------------------
+// Redimensionnement de l'image planaire
+//------------------------------------------------------------------------------
+PLANAR_IMAGE *bilinear_resize_planar(PLANAR_IMAGE *image, unsigned short width, unsigned short height);
+
+//------------------------------------------------------------------------------
+// Creation d'un tableau de pixels (index dans la palette, width * height)
+//------------------------------------------------------------------------------
+unsigned char *create_pixels_array_planar(PLANAR_IMAGE *image, PALETTE *palette);
+
+//------------------------------------------------------------------------------
+// Histogramme des couleurs de l'image planaire
+//------------------------------------------------------------------------------
+COLORS_HISTOGRAM *create_colors_histogram_planar(PLANAR_IMAGE *image);
+
+//------------------------------------------------------------------------------
+// Histogramme des lignes [y0, y1) de l'image planaire
+//------------------------------------------------------------------------------
+COLORS_HISTOGRAM *create_colors_histogram_planar_rows(PLANAR_IMAGE *image, int y0, int y1);
+
+#endif
@@ -0,0 +1,153 @@
+#include "pool.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define ALIGN_UP(x, a)	(((x) + (a) - 1) / (a) * (a))
+
+
+
+static int size_class(size_t size)
+{
+	int c = 0;
+	size_t class_size = (size_t)1 << IMAGE_POOL_MIN_SHIFT;
+
+	while (class_size < size) {
+		class_size <<= 1;
+		c++;
+	}
+	return c;
+}
+
+
+
+IMAGE_POOL *create_image_pool()
+{
+	IMAGE_POOL *pool = (IMAGE_POOL *)calloc(1, sizeof(IMAGE_POOL));
+
+	if (pool == NULL)
+		fprintf(stderr, "Impossible de créer le pool d'images\n");
+	return pool;
+}
+
+
+
+void free_image_pool(IMAGE_POOL *pool)
+{
+	if (pool == NULL)
+		return;
+
+	for (int c = 0; c < IMAGE_POOL_CLASSES; c++)
+		for (int i = 0; i < pool->counts[c]; i++)
+			aligned_free(pool->buffers[c][i]);
+	free(pool);
+}
+
+
+
+void *pool_alloc(IMAGE_POOL *pool, size_t size)
+{
+	int c = size_class(size);
+
+	if (c >= IMAGE_POOL_CLASSES)
+		return NULL;
+
+	if (pool->counts[c] > 0)
+		return pool->buffers[c][--pool->counts[c]];
+
+	return aligned_malloc((size_t)1 << (c + IMAGE_POOL_MIN_SHIFT), IMAGE_POOL_ALIGN);
+}
+
+
+
+void pool_free(IMAGE_POOL *pool, void *ptr, size_t size)
+{
+	int c = size_class(size);
+
+	if (ptr == NULL)
+		return;
+
+	if (pool->counts[c] < IMAGE_POOL_DEPTH)
+		pool->buffers[c][pool->counts[c]++] = ptr;
+	else
+		aligned_free(ptr);
+}
+
+
+
+IMAGE *pool_acquire_image(IMAGE_POOL *pool, int w, int h)
+{
+	IMAGE *image = (IMAGE *)malloc(sizeof(IMAGE));
+
+	if (image == NULL) {
+		fprintf(stderr, "Impossible de créer la structure IMAGE\n");
+		return NULL;
+	}
+
+	image->pixels = (PIXEL *)pool_alloc(pool, sizeof(PIXEL) * w * h);
+	if (image->pixels == NULL) {
+		fprintf(stderr, "Impossible de créer le tableau de PIXEL\n");
+		free(image);
+		return NULL;
+	}
+
+	image->width = w;
+	image->height = h;
+	image->pool = pool;
+
+	return image;
+}
+
+
+
+void pool_release_image(IMAGE *image)
+{
+	if (image) {
+		pool_free(image->pool, image->pixels, sizeof(PIXEL) * image->width * image->height);
+		free(image);
+	}
+}
+
+
+
+PLANAR_IMAGE *pool_acquire_planar_image(IMAGE_POOL *pool, int w, int h)
+{
+	PLANAR_IMAGE *image = (PLANAR_IMAGE *)malloc(sizeof(PLANAR_IMAGE));
+
+	if (image == NULL) {
+		fprintf(stderr, "Impossible de créer la structure PLANAR_IMAGE\n");
+		return NULL;
+	}
+
+	int stride = ALIGN_UP(w > 0 ? w : 1, PLANAR_ALIGN);
+	size_t plane_size = (size_t)stride * h;
+	unsigned char *planes = (unsigned char *)pool_alloc(pool, 3 * plane_size);
+
+	if (planes == NULL) {
+		fprintf(stderr, "Impossible de créer les plans de l'image\n");
+		free(image);
+		return NULL;
+	}
+
+	image->width = w;
+	image->height = h;
+	image->stride = stride;
+	image->r = planes;
+	image->g = planes + plane_size;
+	image->b = planes + 2 * plane_size;
+	image->pool = pool;
+
+	return image;
+}
+
+
+
+void pool_release_planar_image(PLANAR_IMAGE *image)
+{
+	if (image) {
+		pool_free(image->pool, image->r, 3 * (size_t)image->stride * image->height);
+		free(image);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "pixel.h"
+#include "planar.h"
+
+
+//------------------------------------------------------------------------------
+// Pool de tampons alignes, ranges par classe de taille (puissances de 2)
+// Les tampons liberes sont gardes pour etre reutilises par la prochaine
+// image de taille comparable. Le pool n'est pas protege contre les acces
+// concurrents : un pool par thread.
+//------------------------------------------------------------------------------
+#define IMAGE_POOL_ALIGN	32
+#define IMAGE_POOL_MIN_SHIFT	12
+#define IMAGE_POOL_CLASSES	36
+#define IMAGE_POOL_DEPTH	4
+
+struct IMAGE_POOL_STRUCT {
+	void *	buffers[IMAGE_POOL_CLASSES][IMAGE_POOL_DEPTH];
+	int	counts[IMAGE_POOL_CLASSES];
+};
+typedef struct IMAGE_POOL_STRUCT IMAGE_POOL;
+
+
+//------------------------------------------------------------------------------
+// Creation / destruction du pool (libere tous les tampons en reserve)
+//------------------------------------------------------------------------------
+IMAGE_POOL *create_image_pool();
+void free_image_pool(IMAGE_POOL *pool);
+
+//------------------------------------------------------------------------------
+// Tampon aligne d'au moins size octets, a rendre avec la meme taille
+//------------------------------------------------------------------------------
+void *pool_alloc(IMAGE_POOL *pool, size_t size);
+void pool_free(IMAGE_POOL *pool, void *ptr, size_t size);
+
+//------------------------------------------------------------------------------
+// Image dont les pixels viennent du pool, pixels non initialises
+// free_image rend les pixels au pool
+//------------------------------------------------------------------------------
+IMAGE *pool_acquire_image(IMAGE_POOL *pool, int w, int h);
+void pool_release_image(IMAGE *image);
+
+//------------------------------------------------------------------------------
+// Image planaire (pas de ligne aligne) dont les plans viennent du pool
+// free_planar_image rend les plans au pool
+//------------------------------------------------------------------------------
+PLANAR_IMAGE *pool_acquire_planar_image(IMAGE_POOL *pool, int w, int h);
+void pool_release_planar_image(PLANAR_IMAGE *image);
+
+#endif
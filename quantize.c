@@ -0,0 +1,777 @@
+#include "quantize.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+#define RED(c)		(((c) >> 16) & 0xFF)
+#define GREEN(c)	(((c) >> 8) & 0xFF)
+#define BLUE(c)		((c) & 0xFF)
+
+
+
+static void set_palette_color(PALETTE *palette, int i, double r, double g, double b)
+{
+	palette->colors[i][0] = (unsigned char)min(max(r + 0.5, 0), 255);
+	palette->colors[i][1] = (unsigned char)min(max(g + 0.5, 0), 255);
+	palette->colors[i][2] = (unsigned char)min(max(b + 0.5, 0), 255);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Coupe mediane
+// Histogramme 5/6/5 bits comme jquant2 mais chaque cellule garde la somme
+// exacte des couleurs pour que la couleur d'une boite soit la vraie moyenne
+//------------------------------------------------------------------------------
+#define MC_C0_BITS	5
+#define MC_C1_BITS	6
+#define MC_C2_BITS	5
+#define MC_C0_SIZE	(1 << MC_C0_BITS)
+#define MC_C1_SIZE	(1 << MC_C1_BITS)
+#define MC_C2_SIZE	(1 << MC_C2_BITS)
+// Ponderation des axes pour le choix de la coupe (R=2, G=3, B=1)
+#define MC_C0_SCALE	2
+#define MC_C1_SCALE	3
+#define MC_C2_SCALE	1
+
+#define MC_INDEX(c0, c1, c2)	(((c0) * MC_C1_SIZE + (c1)) * MC_C2_SIZE + (c2))
+
+struct MC_CELL_STRUCT {
+	unsigned long		count;
+	unsigned long long	sum[3];
+};
+typedef struct MC_CELL_STRUCT MC_CELL;
+
+struct MC_BOX_STRUCT {
+	int	c0min, c0max;
+	int	c1min, c1max;
+	int	c2min, c2max;
+	long	volume;
+	long	colorcount;
+};
+typedef struct MC_BOX_STRUCT MC_BOX;
+
+
+
+//------------------------------------------------------------------------------
+// Reduit la boite aux cellules non vides et met a jour volume et population
+//------------------------------------------------------------------------------
+static void mc_update_box(MC_CELL *cells, MC_BOX *box)
+{
+	int c0min = MC_C0_SIZE, c0max = -1;
+	int c1min = MC_C1_SIZE, c1max = -1;
+	int c2min = MC_C2_SIZE, c2max = -1;
+	long ccount = 0;
+
+	for (int c0 = box->c0min; c0 <= box->c0max; c0++)
+		for (int c1 = box->c1min; c1 <= box->c1max; c1++)
+			for (int c2 = box->c2min; c2 <= box->c2max; c2++)
+				if (cells[MC_INDEX(c0, c1, c2)].count) {
+					c0min = min(c0min, c0); c0max = max(c0max, c0);
+					c1min = min(c1min, c1); c1max = max(c1max, c1);
+					c2min = min(c2min, c2); c2max = max(c2max, c2);
+					ccount++;
+				}
+
+	if (ccount == 0) {
+		box->volume = 0;
+		box->colorcount = 0;
+		return;
+	}
+
+	box->c0min = c0min; box->c0max = c0max;
+	box->c1min = c1min; box->c1max = c1max;
+	box->c2min = c2min; box->c2max = c2max;
+
+	long dist0 = ((c0max - c0min) << (8 - MC_C0_BITS)) * MC_C0_SCALE;
+	long dist1 = ((c1max - c1min) << (8 - MC_C1_BITS)) * MC_C1_SCALE;
+	long dist2 = ((c2max - c2min) << (8 - MC_C2_BITS)) * MC_C2_SCALE;
+
+	box->volume = dist0 * dist0 + dist1 * dist1 + dist2 * dist2;
+	box->colorcount = ccount;
+}
+
+
+
+int quantize_median_cut(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k)
+{
+	MC_CELL *cells = (MC_CELL *)calloc(MC_C0_SIZE * MC_C1_SIZE * MC_C2_SIZE, sizeof(MC_CELL));
+	MC_BOX boxes[32];
+	int numboxes = 1;
+
+	if (cells == NULL) {
+		fprintf(stderr, "Impossible de créer l'histogramme de la coupe mediane\n");
+		return 0;
+	}
+	k = min(max(k, 1), 32);
+
+	for (unsigned int i = 0; i < histogram->size; i++) {
+		unsigned int c = histogram->colors[i];
+		MC_CELL *cell = &cells[MC_INDEX(RED(c) >> (8 - MC_C0_BITS), GREEN(c) >> (8 - MC_C1_BITS), BLUE(c) >> (8 - MC_C2_BITS))];
+
+		cell->count += histogram->counts[i];
+		cell->sum[0] += (unsigned long long)RED(c) * histogram->counts[i];
+		cell->sum[1] += (unsigned long long)GREEN(c) * histogram->counts[i];
+		cell->sum[2] += (unsigned long long)BLUE(c) * histogram->counts[i];
+	}
+
+	boxes[0] = (MC_BOX){ 0, MC_C0_SIZE - 1, 0, MC_C1_SIZE - 1, 0, MC_C2_SIZE - 1, 0, 0 };
+	mc_update_box(cells, &boxes[0]);
+
+	while (numboxes < k) {
+		MC_BOX *b1 = NULL;
+		long best = 0;
+
+		// Premiere moitie : la boite la plus peuplee, ensuite la plus grande
+		for (int i = 0; i < numboxes; i++) {
+			long v = numboxes * 2 <= k ? boxes[i].colorcount : boxes[i].volume;
+			if (boxes[i].volume > 0 && v > best) {
+				best = v;
+				b1 = &boxes[i];
+			}
+		}
+		if (b1 == NULL)
+			break;
+
+		MC_BOX *b2 = &boxes[numboxes];
+		*b2 = *b1;
+
+		int c0 = ((b1->c0max - b1->c0min) << (8 - MC_C0_BITS)) * MC_C0_SCALE;
+		int c1 = ((b1->c1max - b1->c1min) << (8 - MC_C1_BITS)) * MC_C1_SCALE;
+		int c2 = ((b1->c2max - b1->c2min) << (8 - MC_C2_BITS)) * MC_C2_SCALE;
+		int lb;
+
+		// Coupe au milieu de l'axe le plus long
+		if (c1 >= c0 && c1 >= c2) {
+			lb = (b1->c1max + b1->c1min) / 2;
+			b1->c1max = lb;
+			b2->c1min = lb + 1;
+		} else if (c0 >= c2) {
+			lb = (b1->c0max + b1->c0min) / 2;
+			b1->c0max = lb;
+			b2->c0min = lb + 1;
+		} else {
+			lb = (b1->c2max + b1->c2min) / 2;
+			b1->c2max = lb;
+			b2->c2min = lb + 1;
+		}
+
+		mc_update_box(cells, b1);
+		mc_update_box(cells, b2);
+		numboxes++;
+	}
+
+	for (int i = 0; i < numboxes; i++) {
+		unsigned long long total = 0, sum[3] = { 0, 0, 0 };
+
+		for (int c0 = boxes[i].c0min; c0 <= boxes[i].c0max; c0++)
+			for (int c1 = boxes[i].c1min; c1 <= boxes[i].c1max; c1++)
+				for (int c2 = boxes[i].c2min; c2 <= boxes[i].c2max; c2++) {
+					MC_CELL *cell = &cells[MC_INDEX(c0, c1, c2)];
+					total += cell->count;
+					sum[0] += cell->sum[0];
+					sum[1] += cell->sum[1];
+					sum[2] += cell->sum[2];
+				}
+
+		if (total)
+			set_palette_color(palette, i, (double)sum[0] / total, (double)sum[1] / total, (double)sum[2] / total);
+		else
+			set_palette_color(palette, i, 0, 0, 0);
+	}
+
+	free(cells);
+	palette->size = numboxes;
+	strcpy(palette->name, "median cut");
+
+	return numboxes;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Octree
+// Les noeuds sont dans un tableau, les enfants sont des index (0 = aucun)
+// Quand il y a trop de feuilles, un noeud du niveau reductible le plus
+// profond absorbe ses enfants et devient une feuille
+//------------------------------------------------------------------------------
+#define OCTREE_DEPTH		8
+// Nombre de feuilles gardees pendant l'insertion avant la reduction finale
+#define OCTREE_MAX_LEAVES	512
+
+struct OCTREE_NODE_STRUCT {
+	unsigned long long	sum[3];
+	unsigned long		count;
+	int			children[8];
+	int			next;
+	int			leaf;
+};
+typedef struct OCTREE_NODE_STRUCT OCTREE_NODE;
+
+struct OCTREE_STRUCT {
+	OCTREE_NODE *	nodes;
+	int		size;
+	int		capacity;
+	int		free_list;
+	int		leaves;
+	int		reducible[OCTREE_DEPTH];
+};
+typedef struct OCTREE_STRUCT OCTREE;
+
+
+
+static int octree_new_node(OCTREE *tree, int level)
+{
+	int n;
+
+	if (tree->free_list) {
+		n = tree->free_list;
+		tree->free_list = tree->nodes[n].next;
+	} else {
+		if (tree->size == tree->capacity) {
+			OCTREE_NODE *nodes = (OCTREE_NODE *)realloc(tree->nodes, sizeof(OCTREE_NODE) * tree->capacity * 2);
+			if (nodes == NULL)
+				return 0;
+			tree->nodes = nodes;
+			tree->capacity *= 2;
+		}
+		n = tree->size++;
+	}
+
+	memset(&tree->nodes[n], 0, sizeof(OCTREE_NODE));
+	if (level == OCTREE_DEPTH) {
+		tree->nodes[n].leaf = 1;
+		tree->leaves++;
+	} else {
+		tree->nodes[n].next = tree->reducible[level];
+		tree->reducible[level] = n;
+	}
+	return n;
+}
+
+
+
+static void octree_insert(OCTREE *tree, unsigned int c, unsigned long count)
+{
+	int n = 0;
+
+	for (int level = 0; !tree->nodes[n].leaf; level++) {
+		int shift = 7 - level;
+		int i = (((RED(c) >> shift) & 1) << 2) | (((GREEN(c) >> shift) & 1) << 1) | ((BLUE(c) >> shift) & 1);
+
+		if (tree->nodes[n].children[i] == 0) {
+			int child = octree_new_node(tree, level + 1);
+			if (child == 0)
+				return;
+			tree->nodes[n].children[i] = child;
+		}
+		n = tree->nodes[n].children[i];
+	}
+
+	tree->nodes[n].sum[0] += (unsigned long long)RED(c) * count;
+	tree->nodes[n].sum[1] += (unsigned long long)GREEN(c) * count;
+	tree->nodes[n].sum[2] += (unsigned long long)BLUE(c) * count;
+	tree->nodes[n].count += count;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Fusionne les enfants (des feuilles) du noeud n qui devient une feuille
+//------------------------------------------------------------------------------
+static void octree_merge(OCTREE *tree, int n)
+{
+	OCTREE_NODE *node = &tree->nodes[n];
+	int removed = 0;
+
+	for (int i = 0; i < 8; i++) {
+		int child = node->children[i];
+		if (child == 0)
+			continue;
+		node->sum[0] += tree->nodes[child].sum[0];
+		node->sum[1] += tree->nodes[child].sum[1];
+		node->sum[2] += tree->nodes[child].sum[2];
+		node->count += tree->nodes[child].count;
+		tree->nodes[child].next = tree->free_list;
+		tree->free_list = child;
+		node->children[i] = 0;
+		removed++;
+	}
+	node->leaf = 1;
+	tree->leaves -= removed - 1;
+}
+
+
+
+static int octree_deepest_level(OCTREE *tree)
+{
+	int level = OCTREE_DEPTH - 1;
+
+	while (level > 0 && tree->reducible[level] == 0)
+		level--;
+	return level;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Reduction rapide pendant l'insertion : dernier noeud ajoute au niveau le
+// plus profond
+//------------------------------------------------------------------------------
+static void octree_reduce(OCTREE *tree)
+{
+	int level = octree_deepest_level(tree);
+	int n = tree->reducible[level];
+
+	if (level == 0) {
+		octree_merge(tree, 0);
+		return;
+	}
+	tree->reducible[level] = tree->nodes[n].next;
+	octree_merge(tree, n);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Reduction finale : au niveau le plus profond, le noeud le moins peuple
+// parmi ceux qui ne font pas descendre sous k feuilles si possible
+//------------------------------------------------------------------------------
+static void octree_reduce_to(OCTREE *tree, int k)
+{
+	while (tree->leaves > k && !tree->nodes[0].leaf) {
+		int level = octree_deepest_level(tree);
+		int best = 0, best_prev = 0, best_fits = 0;
+		unsigned long best_count = 0;
+
+		if (level == 0) {
+			octree_merge(tree, 0);
+			return;
+		}
+
+		for (int n = tree->reducible[level], prev = 0; n; prev = n, n = tree->nodes[n].next) {
+			unsigned long count = 0;
+			int children = 0;
+
+			for (int i = 0; i < 8; i++) {
+				int child = tree->nodes[n].children[i];
+				if (child) {
+					count += tree->nodes[child].count;
+					children++;
+				}
+			}
+
+			int fits = tree->leaves - (children - 1) >= k;
+			if (best == 0 || (fits && !best_fits) || (fits == best_fits && count < best_count)) {
+				best = n;
+				best_prev = prev;
+				best_fits = fits;
+				best_count = count;
+			}
+		}
+
+		if (best_prev)
+			tree->nodes[best_prev].next = tree->nodes[best].next;
+		else
+			tree->reducible[level] = tree->nodes[best].next;
+		octree_merge(tree, best);
+	}
+}
+
+
+
+static void octree_collect(OCTREE *tree, int n, PALETTE *palette)
+{
+	OCTREE_NODE *node = &tree->nodes[n];
+
+	if (node->leaf) {
+		if (node->count && palette->size < 32) {
+			set_palette_color(palette, palette->size, (double)node->sum[0] / node->count,
+					  (double)node->sum[1] / node->count, (double)node->sum[2] / node->count);
+			palette->size++;
+		}
+		return;
+	}
+	for (int i = 0; i < 8; i++)
+		if (node->children[i])
+			octree_collect(tree, node->children[i], palette);
+}
+
+
+
+int quantize_octree(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k)
+{
+	OCTREE tree;
+
+	k = min(max(k, 1), 32);
+	memset(&tree, 0, sizeof(OCTREE));
+	tree.capacity = 1024;
+	tree.nodes = (OCTREE_NODE *)malloc(sizeof(OCTREE_NODE) * tree.capacity);
+	if (tree.nodes == NULL) {
+		fprintf(stderr, "Impossible de créer l'octree\n");
+		return 0;
+	}
+
+	// Le noeud 0 est la racine, il n'est jamais dans une liste reductible
+	tree.size = 1;
+	memset(&tree.nodes[0], 0, sizeof(OCTREE_NODE));
+
+	for (unsigned int i = 0; i < histogram->size; i++) {
+		octree_insert(&tree, histogram->colors[i], histogram->counts[i]);
+		while (tree.leaves > OCTREE_MAX_LEAVES && !tree.nodes[0].leaf)
+			octree_reduce(&tree);
+	}
+	octree_reduce_to(&tree, k);
+
+	palette->size = 0;
+	octree_collect(&tree, 0, palette);
+	strcpy(palette->name, "octree");
+	free(tree.nodes);
+
+	return palette->size;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Methode de Wu
+// Moments cumules sur une grille 33^3 (5 bits + une ligne de zeros), les
+// boites sont coupees la ou la variance totale diminue le plus
+//------------------------------------------------------------------------------
+#define WU_SIZE		33
+#define WU_INDEX(r, g, b)	(((r) * WU_SIZE + (g)) * WU_SIZE + (b))
+#define WU_RED		2
+#define WU_GREEN	1
+#define WU_BLUE		0
+
+struct WU_BOX_STRUCT {
+	int r0, r1;
+	int g0, g1;
+	int b0, b1;
+	int vol;
+};
+typedef struct WU_BOX_STRUCT WU_BOX;
+
+struct WU_MOMENTS_STRUCT {
+	double *	wt;
+	double *	mr;
+	double *	mg;
+	double *	mb;
+	double *	m2;
+};
+typedef struct WU_MOMENTS_STRUCT WU_MOMENTS;
+
+
+
+static double wu_vol(WU_BOX *cube, double *m)
+{
+	return m[WU_INDEX(cube->r1, cube->g1, cube->b1)]
+	       - m[WU_INDEX(cube->r1, cube->g1, cube->b0)]
+	       - m[WU_INDEX(cube->r1, cube->g0, cube->b1)]
+	       + m[WU_INDEX(cube->r1, cube->g0, cube->b0)]
+	       - m[WU_INDEX(cube->r0, cube->g1, cube->b1)]
+	       + m[WU_INDEX(cube->r0, cube->g1, cube->b0)]
+	       + m[WU_INDEX(cube->r0, cube->g0, cube->b1)]
+	       - m[WU_INDEX(cube->r0, cube->g0, cube->b0)];
+}
+
+
+
+static double wu_bottom(WU_BOX *cube, int dir, double *m)
+{
+	switch (dir) {
+	case WU_RED:
+		return -m[WU_INDEX(cube->r0, cube->g1, cube->b1)]
+		       + m[WU_INDEX(cube->r0, cube->g1, cube->b0)]
+		       + m[WU_INDEX(cube->r0, cube->g0, cube->b1)]
+		       - m[WU_INDEX(cube->r0, cube->g0, cube->b0)];
+	case WU_GREEN:
+		return -m[WU_INDEX(cube->r1, cube->g0, cube->b1)]
+		       + m[WU_INDEX(cube->r1, cube->g0, cube->b0)]
+		       + m[WU_INDEX(cube->r0, cube->g0, cube->b1)]
+		       - m[WU_INDEX(cube->r0, cube->g0, cube->b0)];
+	default:
+		return -m[WU_INDEX(cube->r1, cube->g1, cube->b0)]
+		       + m[WU_INDEX(cube->r1, cube->g0, cube->b0)]
+		       + m[WU_INDEX(cube->r0, cube->g1, cube->b0)]
+		       - m[WU_INDEX(cube->r0, cube->g0, cube->b0)];
+	}
+}
+
+
+
+static double wu_top(WU_BOX *cube, int dir, int pos, double *m)
+{
+	switch (dir) {
+	case WU_RED:
+		return m[WU_INDEX(pos, cube->g1, cube->b1)]
+		       - m[WU_INDEX(pos, cube->g1, cube->b0)]
+		       - m[WU_INDEX(pos, cube->g0, cube->b1)]
+		       + m[WU_INDEX(pos, cube->g0, cube->b0)];
+	case WU_GREEN:
+		return m[WU_INDEX(cube->r1, pos, cube->b1)]
+		       - m[WU_INDEX(cube->r1, pos, cube->b0)]
+		       - m[WU_INDEX(cube->r0, pos, cube->b1)]
+		       + m[WU_INDEX(cube->r0, pos, cube->b0)];
+	default:
+		return m[WU_INDEX(cube->r1, cube->g1, pos)]
+		       - m[WU_INDEX(cube->r1, cube->g0, pos)]
+		       - m[WU_INDEX(cube->r0, cube->g1, pos)]
+		       + m[WU_INDEX(cube->r0, cube->g0, pos)];
+	}
+}
+
+
+
+static double wu_var(WU_MOMENTS *mo, WU_BOX *cube)
+{
+	double dr = wu_vol(cube, mo->mr);
+	double dg = wu_vol(cube, mo->mg);
+	double db = wu_vol(cube, mo->mb);
+	double w = wu_vol(cube, mo->wt);
+
+	return wu_vol(cube, mo->m2) - (dr * dr + dg * dg + db * db) / w;
+}
+
+
+
+static double wu_maximize(WU_MOMENTS *mo, WU_BOX *cube, int dir, int first, int last, int *cut,
+			  double whole_r, double whole_g, double whole_b, double whole_w)
+{
+	double base_r = wu_bottom(cube, dir, mo->mr);
+	double base_g = wu_bottom(cube, dir, mo->mg);
+	double base_b = wu_bottom(cube, dir, mo->mb);
+	double base_w = wu_bottom(cube, dir, mo->wt);
+	double best = 0.0;
+
+	*cut = -1;
+	for (int i = first; i < last; i++) {
+		double half_r = base_r + wu_top(cube, dir, i, mo->mr);
+		double half_g = base_g + wu_top(cube, dir, i, mo->mg);
+		double half_b = base_b + wu_top(cube, dir, i, mo->mb);
+		double half_w = base_w + wu_top(cube, dir, i, mo->wt);
+
+		if (half_w == 0)
+			continue;
+		double temp = (half_r * half_r + half_g * half_g + half_b * half_b) / half_w;
+
+		half_r = whole_r - half_r;
+		half_g = whole_g - half_g;
+		half_b = whole_b - half_b;
+		half_w = whole_w - half_w;
+		if (half_w == 0)
+			continue;
+		temp += (half_r * half_r + half_g * half_g + half_b * half_b) / half_w;
+
+		if (temp > best) {
+			best = temp;
+			*cut = i;
+		}
+	}
+	return best;
+}
+
+
+
+static int wu_cut(WU_MOMENTS *mo, WU_BOX *set1, WU_BOX *set2)
+{
+	int cut_r, cut_g, cut_b, dir;
+	double whole_r = wu_vol(set1, mo->mr);
+	double whole_g = wu_vol(set1, mo->mg);
+	double whole_b = wu_vol(set1, mo->mb);
+	double whole_w = wu_vol(set1, mo->wt);
+
+	double max_r = wu_maximize(mo, set1, WU_RED, set1->r0 + 1, set1->r1, &cut_r, whole_r, whole_g, whole_b, whole_w);
+	double max_g = wu_maximize(mo, set1, WU_GREEN, set1->g0 + 1, set1->g1, &cut_g, whole_r, whole_g, whole_b, whole_w);
+	double max_b = wu_maximize(mo, set1, WU_BLUE, set1->b0 + 1, set1->b1, &cut_b, whole_r, whole_g, whole_b, whole_w);
+
+	if (max_r >= max_g && max_r >= max_b) {
+		dir = WU_RED;
+		if (cut_r < 0)
+			return 0;
+	} else if (max_g >= max_r && max_g >= max_b) {
+		dir = WU_GREEN;
+	} else {
+		dir = WU_BLUE;
+	}
+
+	set2->r1 = set1->r1;
+	set2->g1 = set1->g1;
+	set2->b1 = set1->b1;
+
+	switch (dir) {
+	case WU_RED:
+		set2->r0 = set1->r1 = cut_r;
+		set2->g0 = set1->g0;
+		set2->b0 = set1->b0;
+		break;
+	case WU_GREEN:
+		set2->g0 = set1->g1 = cut_g;
+		set2->r0 = set1->r0;
+		set2->b0 = set1->b0;
+		break;
+	default:
+		set2->b0 = set1->b1 = cut_b;
+		set2->r0 = set1->r0;
+		set2->g0 = set1->g0;
+		break;
+	}
+
+	set1->vol = (set1->r1 - set1->r0) * (set1->g1 - set1->g0) * (set1->b1 - set1->b0);
+	set2->vol = (set2->r1 - set2->r0) * (set2->g1 - set2->g0) * (set2->b1 - set2->b0);
+
+	return 1;
+}
+
+
+
+int quantize_wu(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k)
+{
+	WU_MOMENTS mo;
+	WU_BOX cube[32];
+	double vv[32];
+	int next = 0;
+	double *buffer = (double *)calloc(5 * WU_SIZE * WU_SIZE * WU_SIZE, sizeof(double));
+
+	if (buffer == NULL) {
+		fprintf(stderr, "Impossible de créer les moments de Wu\n");
+		return 0;
+	}
+	k = min(max(k, 1), 32);
+
+	mo.wt = buffer;
+	mo.mr = buffer + WU_SIZE * WU_SIZE * WU_SIZE;
+	mo.mg = buffer + 2 * WU_SIZE * WU_SIZE * WU_SIZE;
+	mo.mb = buffer + 3 * WU_SIZE * WU_SIZE * WU_SIZE;
+	mo.m2 = buffer + 4 * WU_SIZE * WU_SIZE * WU_SIZE;
+
+	// Histogramme 3D
+	for (unsigned int i = 0; i < histogram->size; i++) {
+		unsigned int c = histogram->colors[i];
+		double n = histogram->counts[i];
+		int r = RED(c), g = GREEN(c), b = BLUE(c);
+		int ind = WU_INDEX((r >> 3) + 1, (g >> 3) + 1, (b >> 3) + 1);
+
+		mo.wt[ind] += n;
+		mo.mr[ind] += r * n;
+		mo.mg[ind] += g * n;
+		mo.mb[ind] += b * n;
+		mo.m2[ind] += (double)(r * r + g * g + b * b) * n;
+	}
+
+	// Moments cumules
+	for (int r = 1; r < WU_SIZE; r++) {
+		double area[WU_SIZE], area_r[WU_SIZE], area_g[WU_SIZE], area_b[WU_SIZE], area2[WU_SIZE];
+
+		memset(area, 0, sizeof(area));
+		memset(area_r, 0, sizeof(area_r));
+		memset(area_g, 0, sizeof(area_g));
+		memset(area_b, 0, sizeof(area_b));
+		memset(area2, 0, sizeof(area2));
+
+		for (int g = 1; g < WU_SIZE; g++) {
+			double line = 0, line_r = 0, line_g = 0, line_b = 0, line2 = 0;
+
+			for (int b = 1; b < WU_SIZE; b++) {
+				int ind1 = WU_INDEX(r, g, b);
+				int ind2 = ind1 - WU_SIZE * WU_SIZE;
+
+				line += mo.wt[ind1];
+				line_r += mo.mr[ind1];
+				line_g += mo.mg[ind1];
+				line_b += mo.mb[ind1];
+				line2 += mo.m2[ind1];
+
+				area[b] += line;
+				area_r[b] += line_r;
+				area_g[b] += line_g;
+				area_b[b] += line_b;
+				area2[b] += line2;
+
+				mo.wt[ind1] = mo.wt[ind2] + area[b];
+				mo.mr[ind1] = mo.mr[ind2] + area_r[b];
+				mo.mg[ind1] = mo.mg[ind2] + area_g[b];
+				mo.mb[ind1] = mo.mb[ind2] + area_b[b];
+				mo.m2[ind1] = mo.m2[ind2] + area2[b];
+			}
+		}
+	}
+
+	cube[0].r0 = cube[0].g0 = cube[0].b0 = 0;
+	cube[0].r1 = cube[0].g1 = cube[0].b1 = WU_SIZE - 1;
+
+	int i;
+	for (i = 1; i < k; i++) {
+		if (wu_cut(&mo, &cube[next], &cube[i])) {
+			vv[next] = cube[next].vol > 1 ? wu_var(&mo, &cube[next]) : 0.0;
+			vv[i] = cube[i].vol > 1 ? wu_var(&mo, &cube[i]) : 0.0;
+		} else {
+			vv[next] = 0.0;
+			i--;
+		}
+
+		next = 0;
+		double temp = vv[0];
+		for (int j = 1; j <= i; j++) {
+			if (vv[j] > temp) {
+				temp = vv[j];
+				next = j;
+			}
+		}
+		if (temp <= 0.0) {
+			i++;
+			break;
+		}
+	}
+	k = min(i, k);
+
+	palette->size = 0;
+	for (i = 0; i < k; i++) {
+		double w = wu_vol(&cube[i], mo.wt);
+
+		if (w > 0) {
+			set_palette_color(palette, palette->size, wu_vol(&cube[i], mo.mr) / w,
+					  wu_vol(&cube[i], mo.mg) / w, wu_vol(&cube[i], mo.mb) / w);
+			palette->size++;
+		}
+	}
+	strcpy(palette->name, "wu");
+	free(buffer);
+
+	return palette->size;
+}
+
+
+
+int quantize_histogram(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k, int method)
+{
+	switch (method) {
+	case QUANTIZE_OCTREE:
+		return quantize_octree(histogram, palette, k);
+	case QUANTIZE_WU:
+		return quantize_wu(histogram, palette, k);
+	default:
+		return quantize_median_cut(histogram, palette, k);
+	}
+}
+
+
+
+int quantize_image(IMAGE *image, PALETTE *palette, int k, int method)
+{
+	COLORS_HISTOGRAM *histogram = create_colors_histogram(image);
+	int size;
+
+	if (histogram == NULL)
+		return 0;
+
+	size = quantize_histogram(histogram, palette, k, method);
+	free_colors_histogram(histogram);
+
+	return size;
+}
@@ -0,0 +1,39 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include "pixel.h"
+
+
+//------------------------------------------------------------------------------
+// Methodes de quantification en une passe
+//------------------------------------------------------------------------------
+#define QUANTIZE_MEDIAN_CUT	0
+#define QUANTIZE_OCTREE		1
+#define QUANTIZE_WU		2
+
+
+//------------------------------------------------------------------------------
+// Coupe mediane (comme jquant2 de libjpeg) sur un histogramme 5/6/5 bits
+// Retourne le nombre de couleurs de la palette (au plus k, k <= 32)
+//------------------------------------------------------------------------------
+int quantize_median_cut(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k);
+
+//------------------------------------------------------------------------------
+// Octree avec reduction des noeuds les plus profonds
+// La racine a 8 enfants : si l'image couvre les 8 octants et k < 8, la
+// palette n'a qu'une couleur
+//------------------------------------------------------------------------------
+int quantize_octree(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k);
+
+//------------------------------------------------------------------------------
+// Methode de Wu (minimisation de la variance sur des moments cumules 33^3)
+//------------------------------------------------------------------------------
+int quantize_wu(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k);
+
+//------------------------------------------------------------------------------
+// Quantification d'un histogramme / d'une image avec la methode choisie
+//------------------------------------------------------------------------------
+int quantize_histogram(COLORS_HISTOGRAM *histogram, PALETTE *palette, int k, int method);
+int quantize_image(IMAGE *image, PALETTE *palette, int k, int method);
+
+#endif
@@ -0,0 +1,368 @@
+#include <stdlib.h>
+#include <float.h>
+#include <string.h>
+
+#include "raster.h"
+#include "pixel.h"
+
+
+FRAMEBUFFER *create_framebuffer(SDL_Renderer *renderer, int width, int height) {
+    FRAMEBUFFER *fb = calloc(1, sizeof(FRAMEBUFFER));
+    if (fb == NULL) {
+        return NULL;
+    }
+    fb->width = width;
+    fb->height = height;
+    fb->depth = aligned_malloc((size_t)width * height * sizeof(float), 32);
+    fb->tiles_x = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    fb->tiles_y = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    fb->tile_starts = malloc((fb->tiles_x * fb->tiles_y + 1) * sizeof(int));
+
+    if (renderer != NULL) {
+        fb->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    } else {
+        fb->own_pixels = aligned_malloc((size_t)width * height * sizeof(Uint32), 32);
+        fb->pixels = fb->own_pixels;
+        fb->pitch = width;
+    }
+
+    if (fb->depth == NULL || fb->tile_starts == NULL || (renderer != NULL && fb->texture == NULL) || (renderer == NULL && fb->own_pixels == NULL)) {
+        free_framebuffer(fb);
+        return NULL;
+    }
+    return fb;
+}
+
+
+void free_framebuffer(FRAMEBUFFER *fb) {
+    if (fb == NULL) {
+        return;
+    }
+    if (fb->texture != NULL) {
+        SDL_DestroyTexture(fb->texture);
+    }
+    aligned_free(fb->own_pixels);
+    aligned_free(fb->depth);
+    free(fb->tile_starts);
+    free(fb->tile_points);
+    free(fb);
+}
+
+
+int begin_frame(FRAMEBUFFER *fb, Uint32 clear_color) {
+    if (fb->texture != NULL) {
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(fb->texture, NULL, &pixels, &pitch) != 0) {
+            return 0;
+        }
+        fb->pixels = pixels;
+        fb->pitch = pitch / sizeof(Uint32);
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < fb->height; y++) {
+        Uint32 *p = fb->pixels + (size_t)y * fb->pitch;
+        float *z = fb->depth + (size_t)y * fb->width;
+        for (int x = 0; x < fb->width; x++) {
+            p[x] = clear_color;
+            z[x] = FLT_MAX;
+        }
+    }
+    return 1;
+}
+
+
+void end_frame(FRAMEBUFFER *fb, SDL_Renderer *renderer) {
+    if (fb->texture == NULL) {
+        return;
+    }
+    SDL_UnlockTexture(fb->texture);
+    fb->pixels = NULL;
+    SDL_RenderCopy(renderer, fb->texture, NULL, NULL);
+}
+
+
+static inline Uint32 blend(Uint32 dst, Uint32 src, int alpha) {
+    Uint32 rb = ((src & 0xFF00FF) * alpha + (dst & 0xFF00FF) * (255 - alpha)) >> 8;
+    Uint32 g = ((src & 0x00FF00) * alpha + (dst & 0x00FF00) * (255 - alpha)) >> 8;
+    return 0xFF000000u | (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+
+void raster_point(FRAMEBUFFER *fb, int x, int y, float depth, Uint32 color) {
+    if (x < 0 || y < 0 || x >= fb->width || y >= fb->height || depth <= 0) {
+        return;
+    }
+    float *z = &fb->depth[y * fb->width + x];
+    if (depth < *z) {
+        *z = depth;
+        fb->pixels[y * fb->pitch + x] = color;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Disque plein de rayon radius, avec un anneau d'un pixel de couleur border,
+// limite au rectangle [x0, x1] x [y0, y1]
+//------------------------------------------------------------------------------
+static void raster_disc_clip(FRAMEBUFFER *fb, int x, int y, float depth, int radius, Uint32 color, Uint32 border,
+    int x0, int y0, int x1, int y1) {
+    int r2 = radius * radius;
+    int inner2 = (radius - 1) * (radius - 1);
+    y0 = MAX(y0, y - radius);
+    y1 = MIN(y1, y + radius);
+    x0 = MAX(x0, x - radius);
+    x1 = MIN(x1, x + radius);
+
+    for (int py = y0; py <= y1; py++) {
+        int dy = py - y;
+        float *z = fb->depth + py * fb->width;
+        Uint32 *p = fb->pixels + py * fb->pitch;
+        for (int px = x0; px <= x1; px++) {
+            int dx = px - x;
+            int d2 = dx * dx + dy * dy;
+            if (d2 > r2 || depth >= z[px]) {
+                continue;
+            }
+            z[px] = depth;
+            p[px] = d2 > inner2 ? border : color;
+        }
+    }
+}
+
+
+void raster_disc(FRAMEBUFFER *fb, int x, int y, float depth, int radius, Uint32 color, Uint32 border) {
+    if (depth <= 0) {
+        return;
+    }
+    raster_disc_clip(fb, x, y, depth, radius, color, border, 0, 0, fb->width - 1, fb->height - 1);
+}
+
+
+//------------------------------------------------------------------------------
+// Segment de Bresenham, profondeur interpolee lineairement a l'ecran
+//------------------------------------------------------------------------------
+void raster_line(FRAMEBUFFER *fb, int x0, int y0, float d0, int x1, int y1, float d1,
+    Uint32 color, int alpha) {
+    if (d0 <= 0 || d1 <= 0) {
+        return;
+    }
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    int steps = MAX(dx, -dy);
+    float dd = steps > 0 ? (d1 - d0) / steps : 0;
+    float d = d0;
+
+    for (;;) {
+        if (x0 >= 0 && y0 >= 0 && x0 < fb->width && y0 < fb->height) {
+            float *z = &fb->depth[y0 * fb->width + x0];
+            if (d < *z) {
+                Uint32 *p = &fb->pixels[y0 * fb->pitch + x0];
+                *p = alpha >= 255 ? color : blend(*p, color, alpha);
+            }
+        }
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+        d += dd;
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Tuiles couvertes par un point de rayon radius
+//------------------------------------------------------------------------------
+static inline void point_tiles(FRAMEBUFFER *fb, int x, int y, int radius, int *tx0, int *ty0, int *tx1, int *ty1) {
+    *tx0 = MAX(0, x - radius) / RASTER_TILE_SIZE;
+    *ty0 = MAX(0, y - radius) / RASTER_TILE_SIZE;
+    *tx1 = MIN(fb->width - 1, x + radius) / RASTER_TILE_SIZE;
+    *ty1 = MIN(fb->height - 1, y + radius) / RASTER_TILE_SIZE;
+}
+
+
+//------------------------------------------------------------------------------
+// Rangement par tuile (tri par comptage), l'ordre des points est conserve
+// dans chaque tuile pour garder le resultat du rendu sequentiel
+// Rayon par point dans radii s'il est donne, radius sinon
+//------------------------------------------------------------------------------
+static int bin_points(FRAMEBUFFER *fb, point_cloud *pc, int radius, const unsigned char *radii) {
+    int tiles = fb->tiles_x * fb->tiles_y;
+    int *starts = fb->tile_starts;
+    int tx0, ty0, tx1, ty1;
+
+    memset(starts, 0, (tiles + 1) * sizeof(int));
+    int total = 0;
+    for (int i = 0; i < pc->length; i++) {
+        if (!pc->visible[i] || pc->depth[i] <= 0) {
+            continue;
+        }
+        point_tiles(fb, pc->sx[i], pc->sy[i], radii != NULL ? radii[i] : radius, &tx0, &ty0, &tx1, &ty1);
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                starts[ty * fb->tiles_x + tx + 1]++;
+                total++;
+            }
+        }
+    }
+    for (int t = 0; t < tiles; t++) {
+        starts[t + 1] += starts[t];
+    }
+
+    if (total > fb->tile_capacity) {
+        int *points = realloc(fb->tile_points, total * sizeof(int));
+        if (points == NULL) {
+            return 0;
+        }
+        fb->tile_points = points;
+        fb->tile_capacity = total;
+    }
+
+    // starts[t] sert de curseur d'ecriture, decale d'une tuile au retour
+    for (int i = 0; i < pc->length; i++) {
+        if (!pc->visible[i] || pc->depth[i] <= 0) {
+            continue;
+        }
+        point_tiles(fb, pc->sx[i], pc->sy[i], radii != NULL ? radii[i] : radius, &tx0, &ty0, &tx1, &ty1);
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                fb->tile_points[starts[ty * fb->tiles_x + tx]++] = i;
+            }
+        }
+    }
+    memmove(starts + 1, starts, tiles * sizeof(int));
+    starts[0] = 0;
+    return 1;
+}
+
+
+void raster_point_cloud(FRAMEBUFFER *fb, point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int vertice_size) {
+    project_point_cloud(pc, camera, projection, fb->width, fb->height);
+    raster_projected_point_cloud(fb, pc, vertice_size);
+}
+
+
+//------------------------------------------------------------------------------
+// Rendu par tuiles, les disques des rayons par point n'ont pas de bordure
+//------------------------------------------------------------------------------
+static void raster_tiles(FRAMEBUFFER *fb, point_cloud *pc, int radius, const unsigned char *radii) {
+    Uint32 white = RASTER_RGB(255, 255, 255);
+
+    if (!bin_points(fb, pc, radius, radii)) {
+        return;
+    }
+
+    int tiles = fb->tiles_x * fb->tiles_y;
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < tiles; t++) {
+        int x0 = (t % fb->tiles_x) * RASTER_TILE_SIZE;
+        int y0 = (t / fb->tiles_x) * RASTER_TILE_SIZE;
+        int x1 = MIN(fb->width, x0 + RASTER_TILE_SIZE) - 1;
+        int y1 = MIN(fb->height, y0 + RASTER_TILE_SIZE) - 1;
+
+        for (int j = fb->tile_starts[t]; j < fb->tile_starts[t + 1]; j++) {
+            int i = fb->tile_points[j];
+            int r = radii != NULL ? radii[i] : radius;
+            Uint32 c = RASTER_RGB(pc->r[i], pc->g[i], pc->b[i]);
+            if (r == 0) {
+                int o = pc->sy[i] * fb->width + pc->sx[i];
+                if (pc->depth[i] < fb->depth[o]) {
+                    fb->depth[o] = pc->depth[i];
+                    fb->pixels[pc->sy[i] * fb->pitch + pc->sx[i]] = c;
+                }
+            } else {
+                raster_disc_clip(fb, pc->sx[i], pc->sy[i], pc->depth[i], r, c, radii != NULL ? c : white, x0, y0, x1, y1);
+            }
+        }
+    }
+}
+
+
+void raster_projected_point_cloud(FRAMEBUFFER *fb, point_cloud *pc, int vertice_size) {
+    raster_tiles(fb, pc, vertice_size <= 1 ? 0 : vertice_size, NULL);
+}
+
+
+void raster_projected_point_cloud_sized(FRAMEBUFFER *fb, point_cloud *pc, const unsigned char *radii) {
+    raster_tiles(fb, pc, 0, radii);
+}
+
+
+//------------------------------------------------------------------------------
+// Les aretes des faces visibles sont dessinees en gris semi-transparent, ne
+// modifient pas le z-buffer et passent donc sous les points dessines apres
+//------------------------------------------------------------------------------
+void raster_object(FRAMEBUFFER *fb, object *o, mfloat_t *camera, mfloat_t *projection, int only_vertices, int vertice_size) {
+    mfloat_t mvp[MAT4_SIZE];
+    int *sx, *sy;
+    float *depth;
+    unsigned char *visible;
+
+    if (o->vertices_count == 0) {
+        return;
+    }
+    compute_mvp(mvp, o->model, camera, projection);
+    if (!project_object(o, mvp, fb->width, fb->height, &sx, &sy, &depth, &visible)) {
+        return;
+    }
+
+    for (int i = 0; i < o->length; i++) {
+        face *f = &o->faces[i];
+        int *idx = &o->indexes[f->first];
+
+        int paint_polygon = 1;
+        for (int j = 0; j < f->length; j++) {
+            if (!visible[idx[j]]) {
+                paint_polygon = 0;
+                break;
+            }
+        }
+        if (!paint_polygon) {
+            continue;
+        }
+
+        for (int j = 0; j < f->length; j++) {
+            int a = idx[j];
+            if (only_vertices) {
+                color c = o->vertices[a].colour;
+                if (vertice_size <= 1) {
+                    raster_point(fb, sx[a], sy[a], depth[a], RASTER_RGB(c.r, c.g, c.b));
+                } else {
+                    raster_disc(fb, sx[a], sy[a], depth[a], vertice_size, RASTER_RGB(c.r, c.g, c.b), RASTER_RGB(255, 255, 255));
+                }
+            } else {
+                int b = idx[(j + 1) % f->length];
+                raster_line(fb, sx[a], sy[a], depth[a], sx[b], sy[b], depth[b], RASTER_RGB(64, 64, 64), 128);
+            }
+        }
+    }
+}
+
+
+void raster_projected_polylines(FRAMEBUFFER *fb, point_cloud *pc, int stride, int count) {
+    if (count < 2 || stride * count > pc->length) {
+        return;
+    }
+    for (int t = 1; t < count; t++) {
+        int alpha = 64 + 191 * t / (count - 1);
+        for (int j = 0; j < stride; j++) {
+            int a = (t - 1) * stride + j;
+            int b = t * stride + j;
+            if (!pc->visible[a] || !pc->visible[b]) {
+                continue;
+            }
+            raster_line(fb, pc->sx[a], pc->sy[a], pc->depth[a], pc->sx[b], pc->sy[b], pc->depth[b],
+                RASTER_RGB(pc->r[b], pc->g[b], pc->b[b]), alpha);
+        }
+    }
+}
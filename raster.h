@@ -0,0 +1,75 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <SDL2/SDL.h>
+#include "3d.h"
+
+
+//------------------------------------------------------------------------------
+// Framebuffer ARGB8888 + z-buffer pour le rendu logiciel des points et des
+// aretes. Avec un renderer, les pixels sont ceux d'une texture
+// SDL_TEXTUREACCESS_STREAMING verrouillee entre begin_frame et end_frame et
+// la frame est affichee par un seul SDL_RenderCopy. Sans renderer (mode
+// headless), les pixels sont un simple tableau possede par le framebuffer.
+//------------------------------------------------------------------------------
+typedef struct FRAMEBUFFER {
+    int width;
+    int height;
+    int pitch;              // en pixels
+    Uint32 *pixels;
+    float *depth;
+    SDL_Texture *texture;   // NULL en mode headless
+    Uint32 *own_pixels;     // pixels du mode headless
+    int tiles_x;
+    int tiles_y;
+    int *tile_starts;       // tiles_x * tiles_y + 1 debuts dans tile_points
+    int *tile_points;       // index des points ranges par tuile
+    int tile_capacity;
+} FRAMEBUFFER;
+
+// Cote des tuiles rasterisees en parallele par raster_point_cloud
+#define RASTER_TILE_SIZE 64
+
+#define RASTER_RGB(r, g, b) (0xFF000000u | ((Uint32)(r) << 16) | ((Uint32)(g) << 8) | (Uint32)(b))
+
+FRAMEBUFFER *create_framebuffer(SDL_Renderer *renderer, int width, int height);
+void free_framebuffer(FRAMEBUFFER *fb);
+
+//------------------------------------------------------------------------------
+// Debut de frame : verrouille la texture, efface couleurs et profondeurs
+// Fin de frame : deverrouille et copie la texture sur le renderer
+//------------------------------------------------------------------------------
+int begin_frame(FRAMEBUFFER *fb, Uint32 clear_color);
+void end_frame(FRAMEBUFFER *fb, SDL_Renderer *renderer);
+
+//------------------------------------------------------------------------------
+// Primitives avec test de profondeur (depth = w de la projection, les
+// valeurs <= 0 sont derriere la camera). alpha < 255 melange avec le fond.
+//------------------------------------------------------------------------------
+void raster_point(FRAMEBUFFER *fb, int x, int y, float depth, Uint32 color);
+void raster_disc(FRAMEBUFFER *fb, int x, int y, float depth, int radius, Uint32 color, Uint32 border);
+void raster_line(FRAMEBUFFER *fb, int x0, int y0, float d0, int x1, int y1, float d1,
+    Uint32 color, int alpha);
+
+//------------------------------------------------------------------------------
+// Equivalents de render_point_cloud et render_object dans le framebuffer
+// raster_point_cloud range les points par tuile puis dessine les tuiles en
+// parallele (OpenMP), chaque tuile n'ecrit que dans sa zone du framebuffer.
+// L'appelant reste seul a verrouiller, copier et presenter la texture.
+//------------------------------------------------------------------------------
+void raster_point_cloud(FRAMEBUFFER *fb, point_cloud *pc, mfloat_t *camera, mfloat_t *projection, int vertice_size);
+// Meme rendu pour un nuage deja projete aux dimensions du framebuffer
+void raster_projected_point_cloud(FRAMEBUFFER *fb, point_cloud *pc, int vertice_size);
+// Variante avec un rayon par point (0 : un pixel), disques sans bordure
+void raster_projected_point_cloud_sized(FRAMEBUFFER *fb, point_cloud *pc, const unsigned char *radii);
+void raster_object(FRAMEBUFFER *fb, object *o, mfloat_t *camera, mfloat_t *projection, int only_vertices, int vertice_size);
+
+//------------------------------------------------------------------------------
+// Polylignes d'un nuage deja projete : la ligne j relie les points j,
+// j + stride, j + 2 * stride... (count points). Chaque segment prend la
+// couleur de son point d'arrivee, les premiers segments sont les plus
+// transparents pour montrer le sens du parcours.
+//------------------------------------------------------------------------------
+void raster_projected_polylines(FRAMEBUFFER *fb, point_cloud *pc, int stride, int count);
+
+#endif